@@ -0,0 +1,577 @@
+#include "Alignment.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Radius of the descriptor patch, features closer to the image border are dropped
+const int PATCH_RADIUS{ 15 };
+// Margin of the detected corners (descriptor patch plus the smoothing kernel)
+const int BORDER{ PATCH_RADIUS + 2 };
+// Number of cells per image side used to spread the features
+const int FEATURE_CELLS{ 8 };
+// Minimal number of inliers of an accepted homography
+const int MIN_INLIERS{ 8 };
+
+/// <summary>
+/// Count set bits of a 64-bit word.
+/// </summary>
+static inline int PopCount(uint64_t v)
+{
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(v));
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+/// <summary>
+/// Hamming distance of two 256-bit descriptors.
+/// </summary>
+static inline int Distance(const Feature& a, const Feature& b)
+{
+    return PopCount(a.descriptor[0] ^ b.descriptor[0]) + PopCount(a.descriptor[1] ^ b.descriptor[1]) +
+        PopCount(a.descriptor[2] ^ b.descriptor[2]) + PopCount(a.descriptor[3] ^ b.descriptor[3]);
+}
+
+/// <summary>
+/// Pairs of patch offsets compared by the descriptor, drawn once with a fixed seed so descriptors are comparable between runs.
+/// </summary>
+static const std::vector<int>& BriefPattern()
+{
+    static const std::vector<int> pattern = []()
+    {
+        std::vector<int> offsets;
+        std::mt19937 generator(0x5EED);
+        while (offsets.size() < 256 * 4)
+        {
+            const int dx = static_cast<int>(generator() % (2 * PATCH_RADIUS + 1)) - PATCH_RADIUS;
+            const int dy = static_cast<int>(generator() % (2 * PATCH_RADIUS + 1)) - PATCH_RADIUS;
+            if (dx * dx + dy * dy > PATCH_RADIUS * PATCH_RADIUS) continue;
+            offsets.push_back(dx);
+            offsets.push_back(dy);
+        }
+        return offsets;
+    }();
+    return pattern;
+}
+
+void Homography::Apply(double x, double y, double& u, double& v) const
+{
+    const double w = m[6] * x + m[7] * y + m[8];
+    u = (m[0] * x + m[1] * y + m[2]) / w;
+    v = (m[3] * x + m[4] * y + m[5]) / w;
+}
+
+Homography Homography::Inverse() const
+{
+    Homography inverse;
+    const double det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+    inverse.m[0] = (m[4] * m[8] - m[5] * m[7]) / det;
+    inverse.m[1] = (m[2] * m[7] - m[1] * m[8]) / det;
+    inverse.m[2] = (m[1] * m[5] - m[2] * m[4]) / det;
+    inverse.m[3] = (m[5] * m[6] - m[3] * m[8]) / det;
+    inverse.m[4] = (m[0] * m[8] - m[2] * m[6]) / det;
+    inverse.m[5] = (m[2] * m[3] - m[0] * m[5]) / det;
+    inverse.m[6] = (m[3] * m[7] - m[4] * m[6]) / det;
+    inverse.m[7] = (m[1] * m[6] - m[0] * m[7]) / det;
+    inverse.m[8] = (m[0] * m[4] - m[1] * m[3]) / det;
+    return inverse;
+}
+
+bool Alignment::Align(Image& reference, Image& moving, Homography& homography, const AlignmentSettings& settings, AlignmentStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Feature> features1 = DetectFeatures(reference.DataPtr(), reference.Width(), reference.Height(), settings);
+    std::vector<Feature> features2 = DetectFeatures(moving.DataPtr(), moving.Width(), moving.Height(), settings);
+    auto detected = std::chrono::steady_clock::now();
+
+    std::vector<FeatureMatch> matches = MatchFeatures(features1, features2, settings);
+    auto matched = std::chrono::steady_clock::now();
+
+    int inliers = EstimateHomography(features1, features2, matches, homography, settings);
+    auto estimated = std::chrono::steady_clock::now();
+
+    if (stats)
+    {
+        stats->features1 = static_cast<int>(features1.size());
+        stats->features2 = static_cast<int>(features2.size());
+        stats->matches = static_cast<int>(matches.size());
+        stats->inliers = inliers;
+        stats->detectionTime = std::chrono::duration<double, std::milli>(detected - start).count();
+        stats->matchingTime = std::chrono::duration<double, std::milli>(matched - detected).count();
+        stats->ransacTime = std::chrono::duration<double, std::milli>(estimated - matched).count();
+    }
+
+    if (inliers == 0) return false;
+
+    // The moving image must stay in front of the camera, otherwise its projection is unbounded
+    const int corners[4][2] = { { 0, 0 }, { moving.Width(), 0 }, { 0, moving.Height() }, { moving.Width(), moving.Height() } };
+    for (const auto& corner : corners)
+    {
+        if (homography.m[6] * corner[0] + homography.m[7] * corner[1] + homography.m[8] <= 0) return false;
+    }
+    return true;
+}
+
+std::vector<Feature> Alignment::DetectFeatures(const Color3* pixels, int width, int height, const AlignmentSettings& settings)
+{
+    std::vector<Feature> features;
+    if (width <= 2 * BORDER || height <= 2 * BORDER) return features;
+
+    // Display intensity (0-255) of the luminance
+    std::vector<unsigned char> gray(width * height);
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            const Color3& c = pixels[i * width + j];
+            const float luminance = std::clamp(0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z, 0.0f, 1.0f);
+            gray[i * width + j] = static_cast<unsigned char>(255.99f * std::sqrt(luminance));
+        }
+    }
+
+    // Bresenham circle of radius 3 used by the FAST segment test
+    const int circleX[16] = { 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1 };
+    const int circleY[16] = { -3, -3, -2, -1, 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3 };
+    int circle[16];
+    for (int k = 0; k < 16; k++) circle[k] = circleY[k] * width + circleX[k];
+
+    // Harris response of FAST corners with at least 9 contiguous circle pixels brighter or darker than the centre
+    const int t = settings.fastThreshold;
+    std::vector<float> score(width * height, 0.0f);
+    #pragma omp parallel for
+    for (int i = BORDER; i < height - BORDER; i++)
+    {
+        for (int j = BORDER; j < width - BORDER; j++)
+        {
+            const unsigned char* p = &gray[i * width + j];
+            const int centre = p[0];
+
+            // Any arc of 9 pixels contains at least two of the four compass pixels
+            int brighter = 0;
+            int darker = 0;
+            for (int k = 0; k < 16; k += 4)
+            {
+                brighter += p[circle[k]] > centre + t;
+                darker += p[circle[k]] < centre - t;
+            }
+            if (brighter < 2 && darker < 2) continue;
+
+            unsigned int brighterMask = 0;
+            unsigned int darkerMask = 0;
+            for (int k = 0; k < 16; k++)
+            {
+                brighterMask |= static_cast<unsigned int>(p[circle[k]] > centre + t) << k;
+                darkerMask |= static_cast<unsigned int>(p[circle[k]] < centre - t) << k;
+            }
+            brighterMask |= brighterMask << 16;
+            darkerMask |= darkerMask << 16;
+            bool corner = false;
+            for (int k = 0; k < 16 && !corner; k++)
+            {
+                corner = ((brighterMask >> k) & 0x1FF) == 0x1FF || ((darkerMask >> k) & 0x1FF) == 0x1FF;
+            }
+            if (!corner) continue;
+
+            // Structure tensor of Sobel gradients in a 7x7 window
+            float xx = 0.0f, yy = 0.0f, xy = 0.0f;
+            for (int y = -3; y <= 3; y++)
+            {
+                for (int x = -3; x <= 3; x++)
+                {
+                    const unsigned char* q = p + y * width + x;
+                    const float gx = static_cast<float>((q[1 - width] + 2 * q[1] + q[1 + width]) - (q[-1 - width] + 2 * q[-1] + q[-1 + width]));
+                    const float gy = static_cast<float>((q[width - 1] + 2 * q[width] + q[width + 1]) - (q[-width - 1] + 2 * q[-width] + q[-width + 1]));
+                    xx += gx * gx;
+                    yy += gy * gy;
+                    xy += gx * gy;
+                }
+            }
+            score[i * width + j] = std::max(xx * yy - xy * xy - 0.04f * (xx + yy) * (xx + yy), 0.0f);
+        }
+    }
+
+    // Non-maximum suppression in 3x3 neighbourhoods
+    std::vector<Feature> candidates;
+    #pragma omp parallel
+    {
+        std::vector<Feature> local;
+        #pragma omp for
+        for (int i = BORDER; i < height - BORDER; i++)
+        {
+            for (int j = BORDER; j < width - BORDER; j++)
+            {
+                const float s = score[i * width + j];
+                if (s <= 0.0f) continue;
+                bool maximum = true;
+                for (int y = -1; y <= 1 && maximum; y++)
+                {
+                    for (int x = -1; x <= 1 && maximum; x++)
+                    {
+                        const float n = score[(i + y) * width + j + x];
+                        maximum = n < s || (n == s && (y > 0 || (y == 0 && x >= 0)));
+                    }
+                }
+                if (maximum) local.push_back(Feature{ static_cast<float>(j), static_cast<float>(i), s, { 0, 0, 0, 0 } });
+            }
+        }
+        #pragma omp critical
+        candidates.insert(candidates.end(), local.begin(), local.end());
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Feature& a, const Feature& b)
+    {
+        if (a.score != b.score) return a.score > b.score;
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+
+    // Strongest corners of every cell, so that the features cover the whole image
+    const int perCell = std::max(settings.maxFeatures / (FEATURE_CELLS * FEATURE_CELLS), 1);
+    std::vector<int> cellCount(FEATURE_CELLS * FEATURE_CELLS, 0);
+    for (const Feature& candidate : candidates)
+    {
+        const int cell = (static_cast<int>(candidate.y) * FEATURE_CELLS / height) * FEATURE_CELLS + static_cast<int>(candidate.x) * FEATURE_CELLS / width;
+        if (cellCount[cell] == perCell) continue;
+        cellCount[cell]++;
+        features.push_back(candidate);
+    }
+
+    // Descriptors are computed on the image smoothed by the binomial kernel [1 4 6 4 1] / 16
+    std::vector<unsigned char> tmp(width * height);
+    std::vector<unsigned char> smooth(width * height);
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        const unsigned char* row = &gray[i * width];
+        for (int j = 2; j < width - 2; j++)
+        {
+            tmp[i * width + j] = static_cast<unsigned char>((row[j - 2] + 4 * row[j - 1] + 6 * row[j] + 4 * row[j + 1] + row[j + 2] + 8) >> 4);
+        }
+    }
+    #pragma omp parallel for
+    for (int i = 2; i < height - 2; i++)
+    {
+        for (int j = 2; j < width - 2; j++)
+        {
+            const unsigned char* column = &tmp[i * width + j];
+            smooth[i * width + j] = static_cast<unsigned char>((column[-2 * width] + 4 * column[-width] + 6 * column[0] + 4 * column[width] + column[2 * width] + 8) >> 4);
+        }
+    }
+
+    const std::vector<int>& pattern = BriefPattern();
+    const int count = static_cast<int>(features.size());
+    #pragma omp parallel for
+    for (int k = 0; k < count; k++)
+    {
+        Feature& feature = features[k];
+        const unsigned char* p = &smooth[static_cast<int>(feature.y) * width + static_cast<int>(feature.x)];
+        for (int bit = 0; bit < 256; bit++)
+        {
+            const int* offsets = &pattern[bit * 4];
+            const bool less = p[offsets[1] * width + offsets[0]] < p[offsets[3] * width + offsets[2]];
+            feature.descriptor[bit >> 6] |= static_cast<uint64_t>(less) << (bit & 63);
+        }
+    }
+
+    return features;
+}
+
+std::vector<FeatureMatch> Alignment::MatchFeatures(const std::vector<Feature>& first, const std::vector<Feature>& second, const AlignmentSettings& settings)
+{
+    const int count = static_cast<int>(first.size());
+    std::vector<FeatureMatch> candidates(count, FeatureMatch{ -1, -1, 0 });
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < count; i++)
+    {
+        int best = 257;
+        int secondBest = 257;
+        int bestIndex = -1;
+        for (int j = 0; j < static_cast<int>(second.size()); j++)
+        {
+            const int distance = Distance(first[i], second[j]);
+            if (distance < best)
+            {
+                secondBest = best;
+                best = distance;
+                bestIndex = j;
+            }
+            else if (distance < secondBest)
+            {
+                secondBest = distance;
+            }
+        }
+        if (bestIndex >= 0 && best <= settings.maxDistance && best < settings.ratio * secondBest)
+        {
+            candidates[i] = FeatureMatch{ i, bestIndex, best };
+        }
+    }
+
+    std::vector<FeatureMatch> matches;
+    for (const FeatureMatch& match : candidates)
+    {
+        if (match.first >= 0) matches.push_back(match);
+    }
+    return matches;
+}
+
+int Alignment::EstimateHomography(const std::vector<Feature>& first, const std::vector<Feature>& second, const std::vector<FeatureMatch>& matches, Homography& homography, const AlignmentSettings& settings)
+{
+    const int count = static_cast<int>(matches.size());
+    if (count < MIN_INLIERS) return 0;
+
+    // Points of the moving (second) image and the corresponding reference (first) points
+    std::vector<double> source(2 * count);
+    std::vector<double> destination(2 * count);
+    for (int k = 0; k < count; k++)
+    {
+        source[2 * k] = second[matches[k].second].x;
+        source[2 * k + 1] = second[matches[k].second].y;
+        destination[2 * k] = first[matches[k].first].x;
+        destination[2 * k + 1] = first[matches[k].first].y;
+    }
+
+    const double threshold = static_cast<double>(settings.inlierThreshold) * settings.inlierThreshold;
+    auto isInlier = [&](const Homography& h, int k)
+    {
+        double u, v;
+        h.Apply(source[2 * k], source[2 * k + 1], u, v);
+        const double dx = u - destination[2 * k];
+        const double dy = v - destination[2 * k + 1];
+        return dx * dx + dy * dy < threshold;
+    };
+
+    std::mt19937 generator(42);
+    int bestInliers = 0;
+    Homography best;
+    int iterations = settings.ransacIterations;
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        int sample[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bool repeated;
+            do
+            {
+                sample[k] = static_cast<int>(generator() % count);
+                repeated = false;
+                for (int l = 0; l < k; l++) repeated = repeated || sample[l] == sample[k];
+            } while (repeated);
+        }
+
+        double sampleSource[8], sampleDestination[8];
+        for (int k = 0; k < 4; k++)
+        {
+            sampleSource[2 * k] = source[2 * sample[k]];
+            sampleSource[2 * k + 1] = source[2 * sample[k] + 1];
+            sampleDestination[2 * k] = destination[2 * sample[k]];
+            sampleDestination[2 * k + 1] = destination[2 * sample[k] + 1];
+        }
+
+        Homography h;
+        if (!FitHomography(sampleSource, sampleDestination, 4, h)) continue;
+        // Panoramas never mirror the image
+        if (h.m[0] * h.m[4] - h.m[1] * h.m[3] <= 0) continue;
+
+        int inliers = 0;
+        for (int k = 0; k < count; k++) inliers += isInlier(h, k);
+        if (inliers > bestInliers)
+        {
+            bestInliers = inliers;
+            best = h;
+
+            // Number of hypotheses needed to draw an all-inlier sample with 99.5% probability
+            const double ratio = static_cast<double>(inliers) / count;
+            const double needed = std::log(1.0 - 0.995) / std::log(std::max(1.0 - ratio * ratio * ratio * ratio, 1e-12));
+            iterations = std::min(iterations, static_cast<int>(std::ceil(needed)) + iteration + 1);
+        }
+    }
+
+    if (bestInliers < MIN_INLIERS) return 0;
+
+    // Least-squares refit to all inliers, repeated while the consensus grows
+    homography = best;
+    while (true)
+    {
+        std::vector<double> inlierSource;
+        std::vector<double> inlierDestination;
+        for (int k = 0; k < count; k++)
+        {
+            if (!isInlier(homography, k)) continue;
+            inlierSource.push_back(source[2 * k]);
+            inlierSource.push_back(source[2 * k + 1]);
+            inlierDestination.push_back(destination[2 * k]);
+            inlierDestination.push_back(destination[2 * k + 1]);
+        }
+        const int inliers = static_cast<int>(inlierSource.size() / 2);
+        Homography refined;
+        if (inliers < bestInliers || !FitHomography(inlierSource.data(), inlierDestination.data(), inliers, refined)) break;
+        int refinedInliers = 0;
+        for (int k = 0; k < count; k++) refinedInliers += isInlier(refined, k);
+        if (refinedInliers < inliers) break;
+        homography = refined;
+        bestInliers = refinedInliers;
+        if (refinedInliers == inliers) break;
+    }
+
+    return bestInliers;
+}
+
+bool Alignment::FitHomography(const double* source, const double* destination, int count, Homography& homography)
+{
+    if (count < 4) return false;
+
+    // Normalization moving the centroid to the origin and the mean distance to sqrt(2)
+    auto normalization = [count](const double* points, double& scale, double& cx, double& cy)
+    {
+        cx = cy = 0.0;
+        for (int k = 0; k < count; k++)
+        {
+            cx += points[2 * k];
+            cy += points[2 * k + 1];
+        }
+        cx /= count;
+        cy /= count;
+        double distance = 0.0;
+        for (int k = 0; k < count; k++)
+        {
+            distance += std::sqrt((points[2 * k] - cx) * (points[2 * k] - cx) + (points[2 * k + 1] - cy) * (points[2 * k + 1] - cy));
+        }
+        scale = distance > 0.0 ? std::sqrt(2.0) * count / distance : 0.0;
+    };
+    double sourceScale, sourceX, sourceY, destinationScale, destinationX, destinationY;
+    normalization(source, sourceScale, sourceX, sourceY);
+    normalization(destination, destinationScale, destinationX, destinationY);
+    if (sourceScale == 0.0 || destinationScale == 0.0) return false;
+
+    // Normal equations of the two linear equations per point in the eight unknown entries
+    double ata[8][9] = {};
+    for (int k = 0; k < count; k++)
+    {
+        const double x = (source[2 * k] - sourceX) * sourceScale;
+        const double y = (source[2 * k + 1] - sourceY) * sourceScale;
+        const double u = (destination[2 * k] - destinationX) * destinationScale;
+        const double v = (destination[2 * k + 1] - destinationY) * destinationScale;
+        const double rows[2][9] = {
+            { x, y, 1, 0, 0, 0, -u * x, -u * y, u },
+            { 0, 0, 0, x, y, 1, -v * x, -v * y, v } };
+        for (const auto& row : rows)
+        {
+            for (int r = 0; r < 8; r++)
+            {
+                for (int c = 0; c < 9; c++) ata[r][c] += row[r] * row[c];
+            }
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (int c = 0; c < 8; c++)
+    {
+        int pivot = c;
+        for (int r = c + 1; r < 8; r++)
+        {
+            if (std::abs(ata[r][c]) > std::abs(ata[pivot][c])) pivot = r;
+        }
+        if (std::abs(ata[pivot][c]) < 1e-10) return false;
+        for (int k = 0; k < 9; k++) std::swap(ata[c][k], ata[pivot][k]);
+        for (int r = c + 1; r < 8; r++)
+        {
+            const double factor = ata[r][c] / ata[c][c];
+            for (int k = c; k < 9; k++) ata[r][k] -= factor * ata[c][k];
+        }
+    }
+    double h[9];
+    h[8] = 1.0;
+    for (int r = 7; r >= 0; r--)
+    {
+        double sum = ata[r][8];
+        for (int k = r + 1; k < 8; k++) sum -= ata[r][k] * h[k];
+        h[r] = sum / ata[r][r];
+    }
+
+    // Undo the normalization, H = T_destination^-1 * H_normalized * T_source
+    const double inverseScale = 1.0 / destinationScale;
+    double left[9];
+    for (int c = 0; c < 3; c++)
+    {
+        left[c] = inverseScale * h[c] + destinationX * h[6 + c];
+        left[3 + c] = inverseScale * h[3 + c] + destinationY * h[6 + c];
+        left[6 + c] = h[6 + c];
+    }
+    for (int r = 0; r < 3; r++)
+    {
+        homography.m[3 * r] = left[3 * r] * sourceScale;
+        homography.m[3 * r + 1] = left[3 * r + 1] * sourceScale;
+        homography.m[3 * r + 2] = left[3 * r + 2] - left[3 * r] * sourceScale * sourceX - left[3 * r + 1] * sourceScale * sourceY;
+    }
+    if (std::abs(homography.m[8]) < 1e-12) return false;
+    for (int k = 0; k < 9; k++) homography.m[k] /= homography.m[8];
+    return true;
+}
+
+WarpedImage Alignment::Warp(Image& image, const Homography& homography)
+{
+    const int width = image.Width();
+    const int height = image.Height();
+    const Color3* pixels = image.DataPtr();
+
+    // Bounding box of the transformed image
+    double minX = 1e30, minY = 1e30, maxX = -1e30, maxY = -1e30;
+    const int corners[4][2] = { { 0, 0 }, { width - 1, 0 }, { 0, height - 1 }, { width - 1, height - 1 } };
+    for (const auto& corner : corners)
+    {
+        double u, v;
+        homography.Apply(corner[0], corner[1], u, v);
+        minX = std::min(minX, u);
+        minY = std::min(minY, v);
+        maxX = std::max(maxX, u);
+        maxY = std::max(maxY, v);
+    }
+
+    WarpedImage warped;
+    warped.offsetX = static_cast<int>(std::floor(minX));
+    warped.offsetY = static_cast<int>(std::floor(minY));
+    warped.width = static_cast<int>(std::ceil(maxX)) - warped.offsetX + 1;
+    warped.height = static_cast<int>(std::ceil(maxY)) - warped.offsetY + 1;
+    warped.pixels = std::make_unique<Color3[]>(warped.width * warped.height);
+    warped.mask = std::make_unique<unsigned char[]>(warped.width * warped.height);
+
+    // Inverse mapping is affine in the homogeneous coordinates along a row
+    const Homography inverse = homography.Inverse();
+    const double* m = inverse.m;
+
+    #pragma omp parallel for
+    for (int i = 0; i < warped.height; i++)
+    {
+        const double row = warped.offsetY + i;
+        const double column = warped.offsetX;
+        double nu = m[0] * column + m[1] * row + m[2];
+        double nv = m[3] * column + m[4] * row + m[5];
+        double nw = m[6] * column + m[7] * row + m[8];
+        for (int j = 0; j < warped.width; j++, nu += m[0], nv += m[3], nw += m[6])
+        {
+            const int index = i * warped.width + j;
+            const float u = static_cast<float>(nu / nw);
+            const float v = static_cast<float>(nv / nw);
+            if (!(u >= 0.0f && v >= 0.0f && u <= width - 1 && v <= height - 1))
+            {
+                warped.pixels[index] = Color3(0.0f);
+                warped.mask[index] = 0;
+                continue;
+            }
+            const int x = std::min(static_cast<int>(u), width - 2);
+            const int y = std::min(static_cast<int>(v), height - 2);
+            const float fx = u - x;
+            const float fy = v - y;
+            const Color3* p = &pixels[y * width + x];
+            warped.pixels[index] = (1.0f - fy) * ((1.0f - fx) * p[0] + fx * p[1]) + fy * ((1.0f - fx) * p[width] + fx * p[width + 1]);
+            warped.mask[index] = 1;
+        }
+    }
+
+    return warped;
+}
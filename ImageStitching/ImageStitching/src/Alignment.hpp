@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Image.hpp"
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Corner with a 256-bit binary descriptor.
+/// </summary>
+struct Feature {
+	float x; // Horizontal position
+	float y; // Vertical position
+	float score; // Harris response
+	uint64_t descriptor[4]; // BRIEF intensity comparisons in a smoothed 31x31 patch
+};
+
+/// <summary>
+/// Pair of corresponding features.
+/// </summary>
+struct FeatureMatch {
+	int first; // Index of the feature of the first image
+	int second; // Index of the feature of the second image
+	int distance; // Hamming distance of the descriptors
+};
+
+/// <summary>
+/// Projective transformation of the plane in homogeneous coordinates (row-major 3x3 matrix).
+/// </summary>
+struct Homography {
+	double m[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+
+	/// <summary>
+	/// Transform a point.
+	/// </summary>
+	/// <param name="x">horizontal position</param>
+	/// <param name="y">vertical position</param>
+	/// <param name="u">transformed horizontal position</param>
+	/// <param name="v">transformed vertical position</param>
+	void Apply(double x, double y, double& u, double& v) const;
+
+	/// <summary>
+	/// Return inverse transformation.
+	/// </summary>
+	/// <returns>inverse</returns>
+	Homography Inverse() const;
+};
+
+/// <summary>
+/// Settings of the feature-based alignment.
+/// </summary>
+struct AlignmentSettings {
+	int fastThreshold = 20; // Intensity difference (0-255) of the FAST segment test
+	int maxFeatures = 2000; // Maximal number of features kept per image, spread over a grid of cells
+	float ratio = 0.8f; // Maximal ratio of the best and the second best descriptor distance of a match
+	int maxDistance = 64; // Maximal Hamming distance of a match
+	int ransacIterations = 2000; // Maximal number of RANSAC hypotheses
+	float inlierThreshold = 3.0f; // Maximal reprojection error of an inlier in pixels
+};
+
+/// <summary>
+/// Statistics of a finished alignment.
+/// </summary>
+struct AlignmentStats {
+	int features1 = 0; // Number of features of the reference image
+	int features2 = 0; // Number of features of the moving image
+	int matches = 0; // Number of descriptor matches
+	int inliers = 0; // Number of matches consistent with the homography
+	double detectionTime = 0; // Corner detection and description in milliseconds
+	double matchingTime = 0; // Descriptor matching in milliseconds
+	double ransacTime = 0; // Homography estimation in milliseconds
+};
+
+/// <summary>
+/// Image resampled into the frame of another image, only pixels with non-zero mask are valid.
+/// </summary>
+struct WarpedImage {
+	std::unique_ptr<Color3[]> pixels; // Resampled pixels
+	std::unique_ptr<unsigned char[]> mask; // Validity of the pixels
+	int width = 0; // Width of the bounding box
+	int height = 0; // Height of the bounding box
+	int offsetX = 0; // Column of the bounding box in the reference frame
+	int offsetY = 0; // Row of the bounding box in the reference frame
+};
+
+/// <summary>
+/// Feature-based registration of two images: FAST corners ranked by the Harris response, BRIEF descriptors,
+/// brute-force Hamming matching with the ratio test and a RANSAC homography.
+/// </summary>
+class Alignment {
+public:
+
+	/// <summary>
+	/// Estimate homography mapping the moving image into the frame of the reference image.
+	/// </summary>
+	/// <param name="reference">reference image</param>
+	/// <param name="moving">moving image</param>
+	/// <param name="homography">output transformation from moving to reference pixels</param>
+	/// <param name="settings">alignment settings</param>
+	/// <param name="stats">optional output of alignment statistics</param>
+	/// <returns>true if a homography supported by enough matches was found</returns>
+	static bool Align(Image& reference, Image& moving, Homography& homography, const AlignmentSettings& settings = AlignmentSettings(), AlignmentStats* stats = nullptr);
+
+	/// <summary>
+	/// Detect corners and compute their descriptors.
+	/// </summary>
+	/// <param name="pixels">image data</param>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <param name="settings">alignment settings</param>
+	/// <returns>features</returns>
+	static std::vector<Feature> DetectFeatures(const Color3* pixels, int width, int height, const AlignmentSettings& settings = AlignmentSettings());
+
+	/// <summary>
+	/// Match features by their Hamming distance, a match is kept if it is clearly better than the second best candidate.
+	/// </summary>
+	/// <param name="first">features of the first image</param>
+	/// <param name="second">features of the second image</param>
+	/// <param name="settings">alignment settings</param>
+	/// <returns>matches</returns>
+	static std::vector<FeatureMatch> MatchFeatures(const std::vector<Feature>& first, const std::vector<Feature>& second, const AlignmentSettings& settings = AlignmentSettings());
+
+	/// <summary>
+	/// Estimate homography from the second features to the first ones by RANSAC followed by a least-squares fit to all inliers.
+	/// </summary>
+	/// <param name="first">features of the first image</param>
+	/// <param name="second">features of the second image</param>
+	/// <param name="matches">matches</param>
+	/// <param name="homography">output transformation</param>
+	/// <param name="settings">alignment settings</param>
+	/// <returns>number of inliers (0 on failure)</returns>
+	static int EstimateHomography(const std::vector<Feature>& first, const std::vector<Feature>& second, const std::vector<FeatureMatch>& matches, Homography& homography, const AlignmentSettings& settings = AlignmentSettings());
+
+	/// <summary>
+	/// Resample image into the reference frame by bilinear interpolation. The output covers the bounding box of the transformed image.
+	/// </summary>
+	/// <param name="image">image to resample</param>
+	/// <param name="homography">transformation from the image to the reference frame</param>
+	/// <returns>warped image</returns>
+	static WarpedImage Warp(Image& image, const Homography& homography);
+
+	/// <summary>
+	/// Fit homography mapping source points to destination points in the least-squares sense (normalized DLT with the last entry fixed to 1).
+	/// </summary>
+	/// <param name="source">source points as x, y pairs</param>
+	/// <param name="destination">destination points as x, y pairs</param>
+	/// <param name="count">number of points (at least 4)</param>
+	/// <param name="homography">output transformation</param>
+	/// <returns>false for degenerate configurations</returns>
+	static bool FitHomography(const double* source, const double* destination, int count, Homography& homography);
+};
@@ -1,5 +1,6 @@
 #include "Image.hpp"
 #include <algorithm>
+#include <chrono>
 
 #define STB_IMAGE_IMPLEMENTATION  
 #include <stb_image.h>
@@ -306,38 +307,121 @@ void Image::UpdateTransformedCDF() {
     }
 }
 
-Color3* Image::ReconstructImage(Color3* gradientX, Color3* gradientY, Image& img2)
+void Image::PoissonRightHandSide(Color3* gradientX, Color3* gradientY, Image& img2, int x0, int x1, Color3* rhs)
+{
+    Color3* img2Data = img2.DataPtr();
+    const int seam = width / 2;
+    const int w = x1 - x0;
+
+    // Fixed pixels next to the solved columns are taken from the cut-and-paste composite
+    auto composite = [&](int i, int j)
+    {
+        return j < seam ? data[i * width + j] : img2Data[i * width + j];
+    };
+
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = x0; j < x1; j++)
+        {
+            const int p = i * width + j;
+            Color3 b(0.0f);
+            // Negative divergence of the forward-difference gradients (links to the left, up, right and down neighbours)
+            if (gradientX)
+            {
+                if (j > 0) b += gradientX[p - 1];
+                if (i > 0) b += gradientY[p - width];
+                if (j + 1 < width) b -= gradientX[p];
+                if (i + 1 < height) b -= gradientY[p];
+            }
+            else
+            {
+                // Forward differences of the image selected by the column
+                const Color3* src = j < seam ? data.get() : img2Data;
+                const Color3* srcLeft = j - 1 < seam ? data.get() : img2Data;
+                if (j > 0) b += srcLeft[p] - srcLeft[p - 1];
+                if (i > 0) b += src[p] - src[p - width];
+                if (j + 1 < width) b -= src[p + 1] - src[p];
+                if (i + 1 < height) b -= src[p + width] - src[p];
+            }
+
+            // Dirichlet boundary values
+            if (i == 0) b += img2Data[i * width + j];
+            if (i == height - 1) b += img2Data[i * width + j];
+            if (j == x0) b += x0 == 0 ? data[i * width + j] : composite(i, x0 - 1);
+            if (j == x1 - 1) b += x1 == width ? img2Data[i * width + j] : composite(i, x1);
+
+            rhs[i * w + j - x0] = b;
+        }
+    }
+}
+
+Color3* Image::ReconstructImage(Color3* gradientX, Color3* gradientY, Image& img2, const PoissonSettings& settings, SolverStats* stats)
 {
     Color3* output = new Color3[width * height];
-    std::fill(output, output + width * height, 0.0f);
-    //std::copy(dataT.get(), dataT.get() + width * height, output);
-    //std::copy(img2.DataPtr(), img2.DataPtr() + width * height, output);
-    Color3* tmpImage = new Color3[width * height];
+    Color3* img2Data = img2.DataPtr();
+
+    // Solved columns, pixels outside of the band around the seam keep their source values
+    const int seam = width / 2;
+    int x0 = 0;
+    int x1 = width;
+    if (settings.band > 0)
+    {
+        x0 = std::max(0, seam - settings.band);
+        x1 = std::min(width, seam + settings.band);
+    }
+    const int w = x1 - x0;
+    const bool fullImage = w == width;
+    // The quadtree solver refines only where the composite is not yet a solution
+    const bool warmStart = settings.warmStart || settings.method == PoissonMethod::Quadtree;
+
+    if (warmStart || !fullImage)
+    {
+        // Cut-and-paste composite of both images
+        for (int i = 0; i < height; i++)
+        {
+            std::copy(data.get() + i * width, data.get() + i * width + seam, output + i * width);
+            std::copy(img2Data + i * width + seam, img2Data + (i + 1) * width, output + i * width + seam);
+        }
+    }
 
-    for (int it = 0; it < 100000; it++)
+    std::unique_ptr<Color3[]> bandImage;
+    Color3* x = output;
+    if (!fullImage)
     {
-        std::copy(output, output + width * height, tmpImage);
+        bandImage = std::make_unique<Color3[]>(w * height);
+        x = bandImage.get();
         for (int i = 0; i < height; i++)
         {
-            #pragma omp parallel for
-            for (int j = 0; j < width; j++)
+            if (warmStart)
+            {
+                std::copy(output + i * width + x0, output + i * width + x1, x + i * w);
+            }
+            else
             {
-                output[i * width + j] = 0.0f;
-                output[i * width + j] += (i - 1) >= 0 ? tmpImage[(i - 1) * width + j] : img2.DataPtr()[i * width + j];
-                output[i * width + j] += (i + 1) < height ? tmpImage[(i + 1) * width + j] : img2.DataPtr()[i * width + j];
-                output[i * width + j] += (j - 1) >= 0 ? tmpImage[i * width + j - 1] : data.get()[i * width + j];
-                output[i * width + j] += (j + 1) < width ? tmpImage[i * width + j + 1] : img2.DataPtr()[i * width + j];
+                std::fill(x + i * w, x + (i + 1) * w, 0.0f);
+            }
+        }
+    }
+    else if (!warmStart)
+    {
+        std::fill(output, output + width * height, 0.0f);
+    }
 
-                output[i * width + j] += gradientX[i * width + j] + gradientY[i * width + j];
-                output[i * width + j] -= (j + 1) < width ? gradientX[i * width + j + 1] : 0;
-                output[i * width + j] -= (i + 1) < height ? gradientY[(i + 1) * width + j] : 0;
+    std::unique_ptr<Color3[]> rhs = std::make_unique<Color3[]>(w * height);
+    PoissonRightHandSide(gradientX, gradientY, img2, x0, x1, rhs.get());
 
-                output[i * width + j] *= 0.25f;
-            }
+    SolverStats solverStats = PoissonSolver::Solve(rhs.get(), x, w, height, settings);
+
+    if (!fullImage)
+    {
+        for (int i = 0; i < height; i++)
+        {
+            std::copy(x + i * w, x + (i + 1) * w, output + i * width + x0);
         }
     }
 
-    delete[] tmpImage;
+    if (stats) *stats = solverStats;
 
     for (int i = 0; i < height; i++)
     {
@@ -352,85 +436,123 @@ Color3* Image::ReconstructImage(Color3* gradientX, Color3* gradientY, Image& img
     return output;
 }
 
-void Image::ImageStitching(Image& img2)
+SolverStats Image::ImageStitching(Image& img2, const PoissonSettings& settings)
 {
-    // Create image gradients
-    Color3* xGrad1 = new Color3[width * height];
-    Color3* yGrad1 = new Color3[width * height];
-    Color3* xGrad2 = new Color3[width * height];
-    Color3* yGrad2 = new Color3[width * height];
+    // The gradients of both images are selected at the seam and turned into the right-hand side on the fly
+    SolverStats stats;
+    Color3* finalImage = ReconstructImage(nullptr, nullptr, img2, settings, &stats);
+    StoreStitchedImage(finalImage);
 
-    Color3* img1Data = this->DataPtr();
-    Color3* img2Data = img2.DataPtr();
+    return stats;
+}
 
-    // x gradients
+void Image::MultiBandStitching(Image& img2, MultiBandBlender& blender, int levels)
+{
+    // Hard seam in the middle, the pyramid turns it into a transition whose width grows with the wavelength
+    std::unique_ptr<float[]> mask = std::make_unique<float[]>(width * height);
+    #pragma omp parallel for
     for (int i = 0; i < height; i++)
     {
-        //xGrad1[i * width + width - 1] = img1Data[i * width + width - 1];
-        //xGrad2[i * width + width - 1] = img2Data[i * width + width - 1];
-        xGrad1[i * width + width - 1] = Color3(0.0f);
-        xGrad2[i * width + width - 1] = Color3(0.0f);
-        for (int j = 0; j < width - 1; j++)
+        for (int j = 0; j < width; j++)
         {
-            xGrad1[i * width + j] = img1Data[i * width + j + 1] - img1Data[i * width + j];
-            xGrad2[i * width + j] = img2Data[i * width + j + 1] - img2Data[i * width + j];
+            mask[i * width + j] = j < width / 2 ? 0.0f : 1.0f;
         }
     }
 
-    // y gradients
-    for (int j = 0; j < width; j++)
+    Color3* output = new Color3[width * height];
+    blender.Blend(data.get(), img2.DataPtr(), mask.get(), width, height, levels, output);
+
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
     {
-        //yGrad1[(height - 1) * width + j] = img1Data[(height - 1) * width + j];
-        //yGrad2[(height - 1) * width + j] = img2Data[(height - 1) * width + j];
-        yGrad1[(height - 1) * width + j] = Color3(0.0f);
-        yGrad2[(height - 1) * width + j] = Color3(0.0f);
-        for (int i = 0; i < height - 1; i++)
+        for (int j = 0; j < width; j++)
         {
-            yGrad1[i * width + j] = img1Data[(i + 1) * width + j] - img1Data[i * width + j];
-            yGrad2[i * width + j] = img2Data[(i + 1) * width + j] - img2Data[i * width + j];
+            output[i * width + j].x = std::clamp(output[i * width + j].x, 0.0f, 1.0f);
+            output[i * width + j].y = std::clamp(output[i * width + j].y, 0.0f, 1.0f);
+            output[i * width + j].z = std::clamp(output[i * width + j].z, 0.0f, 1.0f);
         }
     }
 
+    StoreStitchedImage(output);
+}
 
+double Image::SeamlessClone(Image& img2, MeanValueCloner& cloner, int offsetX, int offsetY)
+{
+    Color3* output = new Color3[width * height];
+    std::copy(data.get(), data.get() + width * height, output);
 
-    //Image imgXDerivatives(xGrad2, width, height);
-    //imgXDerivatives.SavePNG("../Resources/xGradients.png");
-    //Image imgYDerivatives(yGrad2, width, height);
-    //imgYDerivatives.SavePNG("../Resources/yGradients.png");
+    auto start = std::chrono::steady_clock::now();
+    cloner.Clone(img2.DataPtr(), output, width, height, offsetX, offsetY);
+    auto end = std::chrono::steady_clock::now();
 
-    Color3* modifiedGradientsX = new Color3[width * height];
-    Color3* modifiedGradientsY = new Color3[width * height];
+    StoreStitchedImage(output);
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
 
-    for (int i = 0; i < height; i++)
+SolverStats Image::PoissonClone(Image& img2, const float* mask, int offsetX, int offsetY, const PoissonSettings& settings)
+{
+    const int sourceWidth = img2.Width();
+    const int sourceHeight = img2.Height();
+    const Color3* source = img2.DataPtr();
+
+    // Unknowns are masked pixels pasted strictly inside this image
+    std::unique_ptr<float[]> region = std::make_unique<float[]>(sourceWidth * sourceHeight);
+    #pragma omp parallel for
+    for (int i = 0; i < sourceHeight; i++)
     {
-        for (int j = 0; j < width / 2; j++)
+        for (int j = 0; j < sourceWidth; j++)
         {
-            modifiedGradientsX[i * width + j] = xGrad1[i * width + j];
-            modifiedGradientsY[i * width + j] = yGrad1[i * width + j];
+            const int x = j + offsetX;
+            const int y = i + offsetY;
+            const bool inside = x > 0 && y > 0 && x + 1 < width && y + 1 < height;
+            region[i * sourceWidth + j] = inside && mask[i * sourceWidth + j] > 0.0f ? 1.0f : 0.0f;
         }
-        for (int j = width / 2; j < width; j++)
+    }
+    MaskedPoissonSolver solver(region.get(), sourceWidth, sourceHeight);
+    const int n = solver.Unknowns();
+
+    // Laplacian of the source with the fixed neighbours taken from this image, the solve starts from this image
+    std::unique_ptr<Color3[]> rhs = std::make_unique<Color3[]>(n);
+    std::unique_ptr<Color3[]> x = std::make_unique<Color3[]>(n);
+    const int offsets[4] = { -1, 1, -sourceWidth, sourceWidth };
+    const int targetOffsets[4] = { -1, 1, -width, width };
+    #pragma omp parallel for
+    for (int k = 0; k < n; k++)
+    {
+        const int p = solver.Pixel(k);
+        const int t = (p / sourceWidth + offsetY) * width + p % sourceWidth + offsetX;
+        Color3 b = 4.0f * source[p];
+        for (int d = 0; d < 4; d++)
         {
-            modifiedGradientsX[i * width + j] = xGrad2[i * width + j];
-            modifiedGradientsY[i * width + j] = yGrad2[i * width + j];
+            b -= source[p + offsets[d]];
+            if (solver.Neighbour(k, d) < 0) b += data[t + targetOffsets[d]];
         }
+        rhs[k] = b;
+        x[k] = data[t];
     }
 
-    delete[] xGrad1;
-    delete[] xGrad2;
-    delete[] yGrad1;
-    delete[] yGrad2;
+    SolverStats stats = solver.Solve(rhs.get(), x.get(), settings.iterations, settings.tolerance);
 
-    //Image imgXModifiedGrad(modifiedGradientsX, width, height);
-    //imgXModifiedGrad.SavePNG("../Resources/xGradModified.png");
-    //Image imgYModifiedGrad(modifiedGradientsY, width, height);
-    //imgYModifiedGrad.SavePNG("../Resources/yGradModified.png");
-
-    Color3* finalImage = ReconstructImage(modifiedGradientsX, modifiedGradientsY, img2);
+    Color3* output = new Color3[width * height];
+    std::copy(data.get(), data.get() + width * height, output);
+    #pragma omp parallel for
+    for (int k = 0; k < n; k++)
+    {
+        const int p = solver.Pixel(k);
+        const int t = (p / sourceWidth + offsetY) * width + p % sourceWidth + offsetX;
+        output[t].x = std::clamp(x[k].x, 0.0f, 1.0f);
+        output[t].y = std::clamp(x[k].y, 0.0f, 1.0f);
+        output[t].z = std::clamp(x[k].z, 0.0f, 1.0f);
+    }
+    StoreStitchedImage(output);
 
-    Image output(finalImage, width, height);
-    output.SavePNG("../Resources/output.png");
+    return stats;
+}
 
-    dataT = std::unique_ptr<Color3[]>(finalImage);
+void Image::StoreStitchedImage(Color3* image)
+{
+    dataT = std::unique_ptr<Color3[]>(image);
+    SavePNG("../Resources/output.png");
 
     std::fill(distributionT, distributionT + 256, 0);
     distributionT[0] = 0;
@@ -445,10 +567,4 @@ void Image::ImageStitching(Image& img2)
     }
     // Update CDF
     UpdateTransformedCDF();
-
-
-    delete[] modifiedGradientsX;
-    delete[] modifiedGradientsY;
-
-
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Vector3.hpp"
+#include "PoissonSolver.hpp"
+#include "MultiBandBlender.hpp"
+#include "MeanValueCloner.hpp"
+#include "MaskedPoissonSolver.hpp"
 
 /// <summary>
 /// Class representing RGB image.
@@ -141,9 +145,56 @@ public:
 	void NonLinearContrast();
 
 
-	Color3* ReconstructImage(Color3* gradientX, Color3* gradientY, Image& img2);
+	/// <summary>
+	/// Reconstruct image from given gradients by solving the Poisson equation. The left border is fixed to this image, the remaining borders to the second image.
+	/// Null gradients select the gradients of this image left of the seam and of the second image right of it, computed on the fly.
+	/// </summary>
+	/// <param name="gradientX">forward differences in x direction (or null)</param>
+	/// <param name="gradientY">forward differences in y direction (or null)</param>
+	/// <param name="img2">second image</param>
+	/// <param name="settings">Poisson solver settings</param>
+	/// <param name="stats">optional output of solver statistics</param>
+	/// <returns>reconstructed image (owned by the caller)</returns>
+	Color3* ReconstructImage(Color3* gradientX, Color3* gradientY, Image& img2, const PoissonSettings& settings = PoissonSettings(), SolverStats* stats = nullptr);
+
+	/// <summary>
+	/// Stitch this image with the second one in the gradient domain and store the result to the transformed image.
+	/// </summary>
+	/// <param name="img">second image</param>
+	/// <param name="settings">Poisson solver settings</param>
+	/// <returns>solver statistics</returns>
+	SolverStats ImageStitching(Image& img, const PoissonSettings& settings = PoissonSettings());
 
-	void ImageStitching(Image& img);
+	/// <summary>
+	/// Stitch this image with the second one by multi-band blending of the images split at the seam and store the result to the transformed image.
+	/// A fast alternative of the Poisson reconstruction.
+	/// </summary>
+	/// <param name="img">second image</param>
+	/// <param name="blender">blender whose buffers are reused between calls</param>
+	/// <param name="levels">number of pyramid levels (0 picks it from the image size)</param>
+	void MultiBandStitching(Image& img, MultiBandBlender& blender, int levels = 0);
+
+	/// <summary>
+	/// Paste the region prepared in the cloner from the source image into this image by mean-value cloning and store the result to the transformed image.
+	/// </summary>
+	/// <param name="img">source image</param>
+	/// <param name="cloner">cloner prepared for a region of the source image</param>
+	/// <param name="offsetX">position of the source origin in this image</param>
+	/// <param name="offsetY">position of the source origin in this image</param>
+	/// <returns>time of the cloning in milliseconds</returns>
+	double SeamlessClone(Image& img, MeanValueCloner& cloner, int offsetX, int offsetY);
+
+	/// <summary>
+	/// Paste an arbitrary masked region of the source image into this image by solving the Poisson equation on the masked pixels only
+	/// and store the result to the transformed image. The region keeps the gradients of the source and matches this image along its boundary.
+	/// </summary>
+	/// <param name="img">source image</param>
+	/// <param name="mask">mask of the pasted region in source coordinates (non-zero inside)</param>
+	/// <param name="offsetX">position of the source origin in this image</param>
+	/// <param name="offsetY">position of the source origin in this image</param>
+	/// <param name="settings">maximum iterations and tolerance of the conjugate gradient solver</param>
+	/// <returns>solver statistics</returns>
+	SolverStats PoissonClone(Image& img, const float* mask, int offsetX, int offsetY, const PoissonSettings& settings = PoissonSettings());
 
 private:
 
@@ -152,6 +203,25 @@ private:
 	/// </summary>
 	void UpdateTransformedCDF();
 
+	/// <summary>
+	/// Take ownership of a stitched image as the transformed image, save it and update the transformed histogram.
+	/// </summary>
+	/// <param name="image">stitched image</param>
+	void StoreStitchedImage(Color3* image);
+
+	/// <summary>
+	/// Build right-hand side of the Poisson equation on columns [x0, x1) from given gradients with the boundary values of ReconstructImage folded in.
+	/// Columns next to the range are fixed to the cut-and-paste composite of both images. Null gradients are computed from the images
+	/// in the same pass, so no gradient buffers are needed.
+	/// </summary>
+	/// <param name="gradientX">forward differences in x direction (or null)</param>
+	/// <param name="gradientY">forward differences in y direction (or null)</param>
+	/// <param name="img2">second image</param>
+	/// <param name="x0">first solved column</param>
+	/// <param name="x1">end of the solved columns</param>
+	/// <param name="rhs">output right-hand side of size (x1 - x0) x height</param>
+	void PoissonRightHandSide(Color3* gradientX, Color3* gradientY, Image& img2, int x0, int x1, Color3* rhs);
+
 	int histogram[256]; // Histogram of the original image
 	int histogramT[256]; // Histogram of the transformed image
 	float distribution[256]; // CDF of the original image (not normalized)
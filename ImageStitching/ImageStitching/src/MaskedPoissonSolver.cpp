@@ -0,0 +1,139 @@
+#include "MaskedPoissonSolver.hpp"
+#include <algorithm>
+
+MaskedPoissonSolver::MaskedPoissonSolver(const float* mask, int width, int height)
+{
+    std::vector<int> index(width * height, -1);
+    for (int i = 1; i + 1 < height; i++)
+    {
+        for (int j = 1; j + 1 < width; j++)
+        {
+            if (mask[i * width + j] <= 0.0f) continue;
+            index[i * width + j] = static_cast<int>(pixels.size());
+            pixels.push_back(i * width + j);
+        }
+    }
+
+    const int n = Unknowns();
+    neighbours.resize(4 * n);
+    #pragma omp parallel for
+    for (int k = 0; k < n; k++)
+    {
+        const int p = pixels[k];
+        neighbours[4 * k] = index[p - 1];
+        neighbours[4 * k + 1] = index[p + 1];
+        neighbours[4 * k + 2] = index[p - width];
+        neighbours[4 * k + 3] = index[p + width];
+    }
+}
+
+int MaskedPoissonSolver::Unknowns()
+{
+    return static_cast<int>(pixels.size());
+}
+
+int MaskedPoissonSolver::Pixel(int unknown)
+{
+    return pixels[unknown];
+}
+
+int MaskedPoissonSolver::Neighbour(int unknown, int direction)
+{
+    return neighbours[4 * unknown + direction];
+}
+
+Color3 MaskedPoissonSolver::Apply(const Color3* p, Color3* q)
+{
+    const int n = Unknowns();
+    double pqx = 0.0, pqy = 0.0, pqz = 0.0;
+    #pragma omp parallel for reduction(+:pqx, pqy, pqz)
+    for (int k = 0; k < n; k++)
+    {
+        Color3 ap = 4.0f * p[k];
+        for (int d = 0; d < 4; d++)
+        {
+            const int neighbour = neighbours[4 * k + d];
+            if (neighbour >= 0) ap -= p[neighbour];
+        }
+        q[k] = ap;
+        pqx += p[k].x * ap.x;
+        pqy += p[k].y * ap.y;
+        pqz += p[k].z * ap.z;
+    }
+    return Color3(static_cast<float>(pqx), static_cast<float>(pqy), static_cast<float>(pqz));
+}
+
+SolverStats MaskedPoissonSolver::Solve(const Color3* rhs, Color3* x, int iterations, float tolerance)
+{
+    const int n = Unknowns();
+    SolverStats stats;
+    stats.unknowns = n;
+    if (n == 0) return stats;
+
+    std::unique_ptr<Color3[]> r = std::make_unique<Color3[]>(n);
+    std::unique_ptr<Color3[]> p = std::make_unique<Color3[]>(n);
+    std::unique_ptr<Color3[]> q = std::make_unique<Color3[]>(n);
+
+    // Per-channel quotient, channels that already converged exactly stop moving
+    auto divide = [](const Color3& a, const Color3& b)
+    {
+        return Color3(b.x != 0.0f ? a.x / b.x : 0.0f, b.y != 0.0f ? a.y / b.y : 0.0f, b.z != 0.0f ? a.z / b.z : 0.0f);
+    };
+
+    // r = b - A x, the diagonal of A is constant so Jacobi preconditioning would only scale the steps
+    Apply(x, q.get());
+    double rhsSum = 0.0;
+    double rrx = 0.0, rry = 0.0, rrz = 0.0;
+    #pragma omp parallel for reduction(+:rhsSum, rrx, rry, rrz)
+    for (int k = 0; k < n; k++)
+    {
+        r[k] = rhs[k] - q[k];
+        p[k] = r[k];
+        rhsSum += SquaredLength(rhs[k]);
+        rrx += r[k].x * r[k].x;
+        rry += r[k].y * r[k].y;
+        rrz += r[k].z * r[k].z;
+    }
+    const double rhsNorm = rhsSum > 0.0 ? std::sqrt(rhsSum) : 1.0;
+    Color3 rr(static_cast<float>(rrx), static_cast<float>(rry), static_cast<float>(rrz));
+
+    while (stats.iterations < iterations)
+    {
+        const Color3 alpha = divide(rr, Apply(p.get(), q.get()));
+
+        rrx = rry = rrz = 0.0;
+        #pragma omp parallel for reduction(+:rrx, rry, rrz)
+        for (int k = 0; k < n; k++)
+        {
+            x[k] += alpha * p[k];
+            r[k] -= alpha * q[k];
+            rrx += r[k].x * r[k].x;
+            rry += r[k].y * r[k].y;
+            rrz += r[k].z * r[k].z;
+        }
+        stats.iterations++;
+        stats.residual = static_cast<float>(std::sqrt(rrx + rry + rrz) / rhsNorm);
+        stats.history.push_back(stats.residual);
+        if (tolerance > 0.0f && stats.residual <= tolerance) break;
+
+        const Color3 rrNew(static_cast<float>(rrx), static_cast<float>(rry), static_cast<float>(rrz));
+        const Color3 beta = divide(rrNew, rr);
+        rr = rrNew;
+        #pragma omp parallel for
+        for (int k = 0; k < n; k++)
+        {
+            p[k] = r[k] + beta * p[k];
+        }
+    }
+
+    // The recursively updated residual drifts from the true one in single precision
+    Apply(x, q.get());
+    double residualSum = 0.0;
+    #pragma omp parallel for reduction(+:residualSum)
+    for (int k = 0; k < n; k++)
+    {
+        residualSum += SquaredLength(rhs[k] - q[k]);
+    }
+    stats.residual = static_cast<float>(std::sqrt(residualSum) / rhsNorm);
+    return stats;
+}
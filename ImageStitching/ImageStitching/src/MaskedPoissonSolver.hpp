@@ -0,0 +1,68 @@
+#pragma once
+
+#include "PoissonSolver.hpp"
+#include <vector>
+
+/// <summary>
+/// Solver of the Poisson equation A u = b restricted to the pixels of an arbitrary mask.
+/// Only the masked pixels are unknowns, they are numbered compactly in raster order and each one stores the indices of its
+/// four neighbours (-1 for fixed pixels outside the mask), so memory and time scale with the mask area instead of the image.
+/// A is the 5-point Laplacian, values of the fixed neighbours have to be folded into the right-hand side by the caller.
+/// Masked pixels on the image border are left out because they lack a neighbour.
+/// </summary>
+class MaskedPoissonSolver {
+public:
+
+	/// <summary>
+	/// Build the compact index of the masked pixels.
+	/// </summary>
+	/// <param name="mask">mask of the unknowns (non-zero inside)</param>
+	/// <param name="width">mask width</param>
+	/// <param name="height">mask height</param>
+	MaskedPoissonSolver(const float* mask, int width, int height);
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	MaskedPoissonSolver(const MaskedPoissonSolver&) = delete;
+	void operator=(const MaskedPoissonSolver&) = delete;
+	MaskedPoissonSolver(MaskedPoissonSolver&&) = delete;
+	MaskedPoissonSolver& operator=(MaskedPoissonSolver&&) = delete;
+
+	/// <summary>
+	/// Solve the masked system by conjugate gradient starting from the initial guess stored in x.
+	/// </summary>
+	/// <param name="rhs">right-hand side per unknown</param>
+	/// <param name="x">initial guess per unknown, overwritten by the solution</param>
+	/// <param name="iterations">maximum number of iterations</param>
+	/// <param name="tolerance">relative residual at which the iterations stop (0 runs all iterations)</param>
+	/// <returns>number of iterations, final residual, residual history and number of unknowns</returns>
+	SolverStats Solve(const Color3* rhs, Color3* x, int iterations, float tolerance = 0.0f);
+
+	/// <summary>
+	/// Return number of unknowns.
+	/// </summary>
+	int Unknowns();
+
+	/// <summary>
+	/// Return pixel index (y * width + x) of an unknown.
+	/// </summary>
+	int Pixel(int unknown);
+
+	/// <summary>
+	/// Return unknown of a neighbour of an unknown (-1 if the neighbour is fixed).
+	/// </summary>
+	/// <param name="unknown">unknown</param>
+	/// <param name="direction">0 left, 1 right, 2 up, 3 down</param>
+	int Neighbour(int unknown, int direction);
+
+private:
+
+	/// <summary>
+	/// Compute q = A p and return the per-channel dot product p.q.
+	/// </summary>
+	Color3 Apply(const Color3* p, Color3* q);
+
+	std::vector<int> pixels; // Pixel of each unknown
+	std::vector<int> neighbours; // Left, right, up and down neighbour of each unknown (-1 if fixed)
+};
@@ -0,0 +1,381 @@
+#include "MeanValueCloner.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Moore neighbourhood in clockwise order starting to the east (y grows downwards)
+const int NEIGHBOUR_X[8]{ 1, 1, 0, -1, -1, -1, 0, 1 };
+const int NEIGHBOUR_Y[8]{ 0, 1, 1, 1, 0, -1, -1, -1 };
+// Boundary segments longer than this multiple of their distance from a node are split
+const float SPLIT{ 0.5f };
+// Nodes swept together, one per SIMD lane (8 floats of AVX, two SSE registers)
+const int LANES{ 8 };
+
+void MeanValueCloner::TraceBoundary(const float* mask)
+{
+    contour.clear();
+    int start = 0;
+    while (start < width * height && mask[start] <= 0.0f) start++;
+    if (start == width * height) return;
+
+    auto inside = [&](int x, int y)
+    {
+        return x >= 0 && y >= 0 && x < width && y < height && mask[y * width + x] > 0.0f;
+    };
+    auto direction = [](int dx, int dy)
+    {
+        for (int d = 0; d < 8; d++)
+        {
+            if (NEIGHBOUR_X[d] == dx && NEIGHBOUR_Y[d] == dy) return d;
+        }
+        return 0;
+    };
+
+    // Moore neighbour tracing, the first pixel in raster order has background to the west
+    int x = start % width;
+    int y = start / width;
+    int back = 4;
+    int firstMove = -1;
+    while (true)
+    {
+        int move = -1;
+        for (int k = 1; k <= 8; k++)
+        {
+            const int d = (back + k) % 8;
+            if (inside(x + NEIGHBOUR_X[d], y + NEIGHBOUR_Y[d]))
+            {
+                move = d;
+                break;
+            }
+        }
+        if (move < 0)
+        {
+            // Isolated pixel
+            contour.push_back(y * width + x);
+            return;
+        }
+        if (y * width + x == start)
+        {
+            if (move == firstMove) return;
+            if (firstMove < 0) firstMove = move;
+        }
+        contour.push_back(y * width + x);
+
+        // The last background pixel checked becomes the backtrack of the next boundary pixel
+        const int previous = (move + 7) % 8;
+        const int nx = x + NEIGHBOUR_X[move];
+        const int ny = y + NEIGHBOUR_Y[move];
+        back = direction(x + NEIGHBOUR_X[previous] - nx, y + NEIGHBOUR_Y[previous] - ny);
+        x = nx;
+        y = ny;
+    }
+}
+
+bool MeanValueCloner::Prepare(const float* mask, int width, int height, int samples, int step)
+{
+    this->width = width;
+    this->height = height;
+    this->step = std::max(step, 1);
+    TraceBoundary(mask);
+    pixels.clear();
+    nodePixels.clear();
+    differenceX.clear();
+    if (contour.empty())
+    {
+        std::cerr << "ERROR: Cloned region is empty.\n";
+        return false;
+    }
+
+    // Region is the 8-connected component of the boundary
+    std::vector<char> region(width * height, 0);
+    std::vector<int> stack(1, contour[0]);
+    region[contour[0]] = 1;
+    while (!stack.empty())
+    {
+        const int p = stack.back();
+        stack.pop_back();
+        for (int d = 0; d < 8; d++)
+        {
+            const int x = p % width + NEIGHBOUR_X[d];
+            const int y = p / width + NEIGHBOUR_Y[d];
+            if (x < 0 || y < 0 || x >= width || y >= height) continue;
+            const int q = y * width + x;
+            if (region[q] || mask[q] <= 0.0f) continue;
+            region[q] = 1;
+            stack.push_back(q);
+        }
+    }
+    for (int p : contour) region[p] = 2;
+
+    // Interior pixels on the lattice or without four lattice neighbours in the region get their own weights
+    for (int p = 0; p < width * height; p++)
+    {
+        if (region[p] != 1) continue;
+        const int x = p % width;
+        const int y = p / width;
+        const int x0 = x - x % this->step;
+        const int y0 = y - y % this->step;
+        const int x1 = x0 + this->step;
+        const int y1 = y0 + this->step;
+        const bool lattice = x == x0 && y == y0;
+        const bool enclosed = x1 < width && y1 < height && region[y0 * width + x0] && region[y0 * width + x1] && region[y1 * width + x0] && region[y1 * width + x1];
+        if (lattice || !enclosed) nodePixels.push_back(p);
+        else pixels.push_back(p);
+    }
+
+    // Binary hierarchy of boundary segments, segments of one pixel are not split
+    const int length = static_cast<int>(contour.size());
+    int depth = 0;
+    while ((1 << depth) < length) depth++;
+    const int segments = (2 << depth) - 1;
+    segmentStart.assign(segments, -1);
+    segmentEnd.assign(segments, -1);
+    segmentStart[0] = 0;
+    segmentEnd[0] = length;
+    for (int k = 0; 2 * k + 2 < segments; k++)
+    {
+        if (segmentEnd[k] - segmentStart[k] < 2) continue;
+        const int middle = (segmentStart[k] + segmentEnd[k]) / 2;
+        segmentStart[2 * k + 1] = segmentStart[k];
+        segmentEnd[2 * k + 1] = middle;
+        segmentStart[2 * k + 2] = middle;
+        segmentEnd[2 * k + 2] = segmentEnd[k];
+    }
+    int coarseLevel = 0;
+    while ((1 << coarseLevel) < samples) coarseLevel++;
+
+    // Polygon of each node, a segment is split below the coarsest level or if it is long compared to its distance
+    const int nodes = static_cast<int>(nodePixels.size());
+    std::vector<std::vector<int>> polygons(nodes);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int n = 0; n < nodes; n++)
+    {
+        const int x = nodePixels[n] % width;
+        const int y = nodePixels[n] / width;
+        std::vector<std::pair<int, int>> pending(1, std::make_pair(0, 0));
+        while (!pending.empty())
+        {
+            const int k = pending.back().first;
+            const int level = pending.back().second;
+            pending.pop_back();
+            const int size = segmentEnd[k] - segmentStart[k];
+            const int centre = contour[(segmentStart[k] + segmentEnd[k]) / 2];
+            const float distance = std::hypot(static_cast<float>(centre % width - x), static_cast<float>(centre / width - y));
+            if (size > 1 && (level < coarseLevel || size > SPLIT * distance))
+            {
+                // The second child is pushed first so that the vertices follow the boundary
+                pending.push_back(std::make_pair(2 * k + 2, level + 1));
+                pending.push_back(std::make_pair(2 * k + 1, level + 1));
+            }
+            else
+            {
+                polygons[n].push_back(k);
+            }
+        }
+    }
+    std::vector<int> nodeStart(nodes + 1, 0);
+    for (int n = 0; n < nodes; n++) nodeStart[n + 1] = nodeStart[n] + static_cast<int>(polygons[n].size());
+    std::vector<float> vertexWeights(nodeStart[nodes], 0.0f);
+    vertices = nodeStart[nodes];
+
+    // Mean-value coordinates w_k = (tan(a_(k-1) / 2) + tan(a_k / 2)) / r_k, a_k is the angle spanned by the edge k, k + 1
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int n = 0; n < nodes; n++)
+    {
+        const double x = nodePixels[n] % width;
+        const double y = nodePixels[n] / width;
+        const std::vector<int>& polygon = polygons[n];
+        const int count = static_cast<int>(polygon.size());
+        float* row = &vertexWeights[nodeStart[n]];
+        std::vector<double> vertexX(count), vertexY(count), distance(count), halfTangent(count), w(count);
+        int degenerate = -1;
+        for (int k = 0; k < count; k++)
+        {
+            const int p = contour[(segmentStart[polygon[k]] + segmentEnd[polygon[k]]) / 2];
+            vertexX[k] = p % width;
+            vertexY[k] = p / width;
+            distance[k] = std::hypot(vertexX[k] - x, vertexY[k] - y);
+            if (distance[k] < 1e-9) degenerate = k;
+        }
+        if (degenerate >= 0)
+        {
+            row[degenerate] = 1.0f;
+            continue;
+        }
+
+        int edge = -1;
+        for (int k = 0; k < count; k++)
+        {
+            const int l = (k + 1) % count;
+            const double ax = vertexX[k] - x, ay = vertexY[k] - y;
+            const double bx = vertexX[l] - x, by = vertexY[l] - y;
+            const double denominator = distance[k] * distance[l] + ax * bx + ay * by;
+            if (count > 1 && denominator <= 1e-9 * distance[k] * distance[l])
+            {
+                edge = k;
+                break;
+            }
+            halfTangent[k] = count > 1 ? (ax * by - ay * bx) / denominator : 0.0;
+        }
+        if (edge >= 0)
+        {
+            // Node lies on a polygon edge, interpolate linearly between its ends
+            const int l = (edge + 1) % count;
+            const double t = distance[edge] / (distance[edge] + distance[l]);
+            row[edge] = static_cast<float>(1.0 - t);
+            row[l] += static_cast<float>(t);
+            continue;
+        }
+
+        double sum = 0.0;
+        for (int k = 0; k < count; k++)
+        {
+            w[k] = (halfTangent[(k + count - 1) % count] + halfTangent[k]) / distance[k];
+            sum += w[k];
+        }
+        for (int k = 0; k < count; k++)
+        {
+            row[k] = sum != 0.0 ? static_cast<float>(w[k] / sum) : 1.0f / count;
+        }
+    }
+
+    // Blocks of LANES consecutive nodes share one list of segments, the union of their polygons, with a row of LANES weights
+    // per segment. Neighbouring nodes have nearly the same polygons, so the union is little longer than a single polygon.
+    const int blocks = (nodes + LANES - 1) / LANES;
+    std::vector<std::vector<int>> blockSegments(blocks);
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int b = 0; b < blocks; b++)
+    {
+        std::vector<int>& list = blockSegments[b];
+        for (int n = b * LANES; n < std::min((b + 1) * LANES, nodes); n++)
+        {
+            list.insert(list.end(), polygons[n].begin(), polygons[n].end());
+        }
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+    blockStart.assign(blocks + 1, 0);
+    for (int b = 0; b < blocks; b++) blockStart[b + 1] = blockStart[b] + static_cast<int>(blockSegments[b].size());
+    rowSegment.resize(blockStart[blocks]);
+    weights.assign(static_cast<size_t>(blockStart[blocks]) * LANES, 0.0f);
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int b = 0; b < blocks; b++)
+    {
+        const std::vector<int>& list = blockSegments[b];
+        std::copy(list.begin(), list.end(), rowSegment.begin() + blockStart[b]);
+        for (int n = b * LANES; n < std::min((b + 1) * LANES, nodes); n++)
+        {
+            for (int k = 0; k < static_cast<int>(polygons[n].size()); k++)
+            {
+                const int row = static_cast<int>(std::lower_bound(list.begin(), list.end(), polygons[n][k]) - list.begin());
+                weights[static_cast<size_t>(blockStart[b] + row) * LANES + n - b * LANES] = vertexWeights[nodeStart[n] + k];
+            }
+        }
+    }
+
+    differenceX.assign(segments, 0.0f);
+    differenceY.assign(segments, 0.0f);
+    differenceZ.assign(segments, 0.0f);
+    prefix.resize(length + 1);
+    membrane.assign(width * height, Color3(0.0f));
+    return true;
+}
+
+void MeanValueCloner::Clone(const Color3* source, Color3* target, int targetWidth, int targetHeight, int offsetX, int offsetY)
+{
+    if (differenceX.empty()) return;
+
+    // Differences along the boundary, positions outside of the target use its nearest pixel
+    const int length = static_cast<int>(contour.size());
+    prefix[0] = Color3(0.0f);
+    for (int c = 0; c < length; c++)
+    {
+        const int p = contour[c];
+        const int x = std::clamp(p % width + offsetX, 0, targetWidth - 1);
+        const int y = std::clamp(p / width + offsetY, 0, targetHeight - 1);
+        membrane[p] = target[y * targetWidth + x] - source[p];
+        prefix[c + 1] = prefix[c] + membrane[p];
+    }
+    const int segments = static_cast<int>(segmentStart.size());
+    for (int k = 0; k < segments; k++)
+    {
+        if (segmentStart[k] < 0) continue;
+        const Color3 mean = (prefix[segmentEnd[k]] - prefix[segmentStart[k]]) / static_cast<float>(segmentEnd[k] - segmentStart[k]);
+        differenceX[k] = mean.x;
+        differenceY[k] = mean.y;
+        differenceZ[k] = mean.z;
+    }
+
+    // Sweep of the weights, LANES nodes at a time. A row broadcasts the difference of one segment to the contiguous weights
+    // of all nodes of the block, so the inner loop is a multiply-add over the lanes without gathers and vectorizes.
+    const int nodes = static_cast<int>(nodePixels.size());
+    const int blocks = static_cast<int>(blockStart.size()) - 1;
+    #pragma omp parallel for
+    for (int b = 0; b < blocks; b++)
+    {
+        float sx[LANES] = {}, sy[LANES] = {}, sz[LANES] = {};
+        for (int r = blockStart[b]; r < blockStart[b + 1]; r++)
+        {
+            const float* w = &weights[static_cast<size_t>(r) * LANES];
+            const float dx = differenceX[rowSegment[r]];
+            const float dy = differenceY[rowSegment[r]];
+            const float dz = differenceZ[rowSegment[r]];
+            for (int l = 0; l < LANES; l++)
+            {
+                sx[l] += w[l] * dx;
+                sy[l] += w[l] * dy;
+                sz[l] += w[l] * dz;
+            }
+        }
+        for (int l = 0; l < LANES && b * LANES + l < nodes; l++)
+        {
+            membrane[nodePixels[b * LANES + l]] = Color3(sx[l], sy[l], sz[l]);
+        }
+    }
+
+    // Remaining interior pixels lie inside a lattice cell whose corners are known
+    const int interpolated = static_cast<int>(pixels.size());
+    #pragma omp parallel for
+    for (int k = 0; k < interpolated; k++)
+    {
+        const int p = pixels[k];
+        const int x0 = p % width - (p % width) % step;
+        const int y0 = p / width - (p / width) % step;
+        const float fx = static_cast<float>(p % width - x0) / step;
+        const float fy = static_cast<float>(p / width - y0) / step;
+        const int q = y0 * width + x0;
+        membrane[p] = (1.0f - fy) * ((1.0f - fx) * membrane[q] + fx * membrane[q + step]) +
+            fy * ((1.0f - fx) * membrane[q + step * width] + fx * membrane[q + step * width + step]);
+    }
+
+    auto paste = [&](int p)
+    {
+        const int x = p % width + offsetX;
+        const int y = p / width + offsetY;
+        if (x < 0 || y < 0 || x >= targetWidth || y >= targetHeight) return;
+        Color3 value = source[p] + membrane[p];
+        value.x = std::clamp(value.x, 0.0f, 1.0f);
+        value.y = std::clamp(value.y, 0.0f, 1.0f);
+        value.z = std::clamp(value.z, 0.0f, 1.0f);
+        target[y * targetWidth + x] = value;
+    };
+    #pragma omp parallel for
+    for (int n = 0; n < nodes; n++)
+    {
+        paste(nodePixels[n]);
+    }
+    #pragma omp parallel for
+    for (int k = 0; k < interpolated; k++)
+    {
+        paste(pixels[k]);
+    }
+}
+
+float MeanValueCloner::Samples()
+{
+    return nodePixels.empty() ? 0.0f : static_cast<float>(vertices) / nodePixels.size();
+}
+
+int MeanValueCloner::Nodes()
+{
+    return static_cast<int>(nodePixels.size());
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <vector>
+
+/// <summary>
+/// Seamless cloning by mean-value coordinates (Farbman et al., Coordinates for Instant Image Cloning).
+/// The membrane which the Poisson equation adds to a pasted region is replaced by the mean-value interpolation of the
+/// differences between target and source along the region boundary. The boundary is split into a binary hierarchy of
+/// segments, each node uses a polygon of fine segments close to it and coarse segments far away (adaptive sampling of the
+/// paper). The weights are computed once per region on a lattice of nodes (every pixel near the boundary, a sparse grid
+/// inside), each edit only averages the differences over all segments, sweeps the weights of all nodes and interpolates
+/// the membrane bilinearly. The weights of blocks of consecutive nodes are stored transposed, one row per segment of the union
+/// of their polygons, so that the sweep handles the nodes of a block in SIMD lanes.
+/// </summary>
+class MeanValueCloner {
+public:
+
+	MeanValueCloner() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	MeanValueCloner(const MeanValueCloner&) = delete;
+	void operator=(const MeanValueCloner&) = delete;
+	MeanValueCloner(MeanValueCloner&&) = delete;
+	MeanValueCloner& operator=(MeanValueCloner&&) = delete;
+
+	/// <summary>
+	/// Precompute the weights of a cloned region, the outer boundary of its first connected component is used.
+	/// </summary>
+	/// <param name="mask">region mask of the source image (non-zero inside)</param>
+	/// <param name="width">source width</param>
+	/// <param name="height">source height</param>
+	/// <param name="samples">number of segments of the coarsest boundary polygon</param>
+	/// <param name="step">spacing of the interior nodes, pixels between them are interpolated</param>
+	/// <returns>false if the mask is empty</returns>
+	bool Prepare(const float* mask, int width, int height, int samples = 16, int step = 4);
+
+	/// <summary>
+	/// Paste the region of the source image into the target so that it matches the target along its boundary.
+	/// </summary>
+	/// <param name="source">source image of the size given to Prepare</param>
+	/// <param name="target">target image, the region is written into it</param>
+	/// <param name="targetWidth">target width</param>
+	/// <param name="targetHeight">target height</param>
+	/// <param name="offsetX">position of the source origin in the target</param>
+	/// <param name="offsetY">position of the source origin in the target</param>
+	void Clone(const Color3* source, Color3* target, int targetWidth, int targetHeight, int offsetX, int offsetY);
+
+	/// <summary>
+	/// Return average number of boundary polygon vertices of a node.
+	/// </summary>
+	float Samples();
+
+	/// <summary>
+	/// Return number of nodes with precomputed weights.
+	/// </summary>
+	int Nodes();
+
+private:
+
+	/// <summary>
+	/// Trace the outer boundary of the component containing the first masked pixel in raster order.
+	/// </summary>
+	void TraceBoundary(const float* mask);
+
+	int width = 0; // Source width
+	int height = 0; // Source height
+	int step = 1; // Spacing of the interior nodes
+	std::vector<int> contour; // Boundary pixels in order along the boundary
+	std::vector<int> segmentStart; // Contour range [start, end) of each segment of the hierarchy, children of segment s are 2s + 1 and 2s + 2
+	std::vector<int> segmentEnd;
+	std::vector<int> nodePixels; // Interior pixels with precomputed weights
+	std::vector<int> pixels; // Interior pixels interpolated from the corners of their lattice cell
+	std::vector<int> blockStart; // First weight row of each block of consecutive nodes swept together
+	std::vector<int> rowSegment; // Segment of each weight row
+	std::vector<float> weights; // Normalized weights of one segment for every node of the block per row, 0 if the segment is not in the polygon of the node
+	int vertices = 0; // Number of polygon vertices of all nodes
+	std::vector<float> differenceX; // Mean boundary difference of the current edit per segment and channel
+	std::vector<float> differenceY;
+	std::vector<float> differenceZ;
+	std::vector<Color3> prefix; // Prefix sums of the differences along the contour
+	std::vector<Color3> membrane; // Interpolated difference at each pixel of the source
+};
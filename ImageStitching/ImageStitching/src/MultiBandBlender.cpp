@@ -0,0 +1,202 @@
+#include "MultiBandBlender.hpp"
+#include <algorithm>
+
+/// <summary>
+/// Filter by the binomial kernel [1 4 6 4 1] / 16 in both directions and keep every second pixel.
+/// The borders are clamped.
+/// </summary>
+template <typename T>
+static void Reduce(const T* fine, int fineWidth, int fineHeight, T* coarse, int coarseWidth, int coarseHeight, T* tmp)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < fineHeight; i++)
+    {
+        const T* row = fine + i * fineWidth;
+        for (int j = 0; j < coarseWidth; j++)
+        {
+            const int x = 2 * j;
+            const T sum = row[std::max(x - 2, 0)] + 4.0f * row[std::max(x - 1, 0)] + 6.0f * row[x] +
+                4.0f * row[std::min(x + 1, fineWidth - 1)] + row[std::min(x + 2, fineWidth - 1)];
+            tmp[i * coarseWidth + j] = sum * (1.0f / 16.0f);
+        }
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < coarseHeight; i++)
+    {
+        const int y = 2 * i;
+        const T* row0 = tmp + std::max(y - 2, 0) * coarseWidth;
+        const T* row1 = tmp + std::max(y - 1, 0) * coarseWidth;
+        const T* row2 = tmp + y * coarseWidth;
+        const T* row3 = tmp + std::min(y + 1, fineHeight - 1) * coarseWidth;
+        const T* row4 = tmp + std::min(y + 2, fineHeight - 1) * coarseWidth;
+        for (int j = 0; j < coarseWidth; j++)
+        {
+            coarse[i * coarseWidth + j] = (row0[j] + 4.0f * row1[j] + 6.0f * row2[j] + 4.0f * row3[j] + row4[j]) * (1.0f / 16.0f);
+        }
+    }
+}
+
+/// <summary>
+/// Upsample by two and interpolate with the same kernel (fine pixel 2c coincides with coarse pixel c).
+/// </summary>
+template <typename T>
+static void Expand(const T* coarse, int coarseWidth, int coarseHeight, T* fine, int fineWidth, int fineHeight, T* tmp)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < coarseHeight; i++)
+    {
+        const T* row = coarse + i * coarseWidth;
+        for (int j = 0; j < fineWidth; j++)
+        {
+            const int c = j >> 1;
+            tmp[i * fineWidth + j] = (j & 1) == 0 ?
+                (row[std::max(c - 1, 0)] + 6.0f * row[c] + row[std::min(c + 1, coarseWidth - 1)]) * 0.125f :
+                (row[c] + row[std::min(c + 1, coarseWidth - 1)]) * 0.5f;
+        }
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < fineHeight; i++)
+    {
+        const int c = i >> 1;
+        const T* row0 = tmp + std::max(c - 1, 0) * fineWidth;
+        const T* row1 = tmp + c * fineWidth;
+        const T* row2 = tmp + std::min(c + 1, coarseHeight - 1) * fineWidth;
+        if ((i & 1) == 0)
+        {
+            for (int j = 0; j < fineWidth; j++) fine[i * fineWidth + j] = (row0[j] + 6.0f * row1[j] + row2[j]) * 0.125f;
+        }
+        else
+        {
+            for (int j = 0; j < fineWidth; j++) fine[i * fineWidth + j] = (row1[j] + row2[j]) * 0.5f;
+        }
+    }
+}
+
+int MultiBandBlender::Levels()
+{
+    return static_cast<int>(levels.size());
+}
+
+void MultiBandBlender::Reserve(int width, int height, int levelCount)
+{
+    levels.clear();
+    Level level{ width, height, nullptr, nullptr, nullptr };
+    levels.push_back(level);
+    while (true)
+    {
+        const int w = (level.width + 1) / 2;
+        const int h = (level.height + 1) / 2;
+        const bool reduce = levelCount > 0 ? static_cast<int>(levels.size()) < levelCount && level.width > 1 && level.height > 1 : std::min(w, h) >= 16;
+        if (!reduce) break;
+        level.width = w;
+        level.height = h;
+        levels.push_back(level);
+    }
+
+    // The finest level is read from the inputs and written to the output, only the coarser ones live in the arena
+    size_t pixels = 0;
+    for (size_t k = 1; k < levels.size(); k++) pixels += static_cast<size_t>(levels[k].width) * levels[k].height;
+    const size_t finest = static_cast<size_t>(width) * height;
+
+    if (colorCapacity < 2 * pixels + 2 * finest)
+    {
+        colorCapacity = 2 * pixels + 2 * finest;
+        colorArena = std::make_unique<Color3[]>(colorCapacity);
+    }
+    if (maskCapacity < pixels + finest)
+    {
+        maskCapacity = pixels + finest;
+        maskArena = std::make_unique<float[]>(maskCapacity);
+    }
+
+    Color3* color = colorArena.get();
+    float* mask = maskArena.get();
+    for (size_t k = 1; k < levels.size(); k++)
+    {
+        const size_t size = static_cast<size_t>(levels[k].width) * levels[k].height;
+        levels[k].first = color;
+        levels[k].second = color + size;
+        levels[k].mask = mask;
+        color += 2 * size;
+        mask += size;
+    }
+    scratch = color;
+    expanded = color + finest;
+    maskScratch = mask;
+}
+
+void MultiBandBlender::Blend(const Color3* first, const Color3* second, const float* mask, int width, int height, int levelCount, Color3* output)
+{
+    Reserve(width, height, levelCount);
+    const int count = static_cast<int>(levels.size());
+
+    // Gaussians of level k, the finest level are the inputs
+    auto gaussianFirst = [&](int k) { return k == 0 ? first : levels[k].first; };
+    auto gaussianSecond = [&](int k) { return k == 0 ? second : levels[k].second; };
+    auto gaussianMask = [&](int k) { return k == 0 ? mask : levels[k].mask; };
+
+    for (int k = 0; k + 1 < count; k++)
+    {
+        const Level& fine = levels[k];
+        const Level& coarse = levels[k + 1];
+        Reduce(gaussianFirst(k), fine.width, fine.height, coarse.first, coarse.width, coarse.height, scratch);
+        Reduce(gaussianSecond(k), fine.width, fine.height, coarse.second, coarse.width, coarse.height, scratch);
+        Reduce(gaussianMask(k), fine.width, fine.height, coarse.mask, coarse.width, coarse.height, maskScratch);
+    }
+
+    // Blended Laplacian bands are stored in place of the Gaussians of the first image (in the output on the finest level),
+    // from fine to coarse so the next level is still Gaussian
+    for (int k = 0; k + 1 < count; k++)
+    {
+        const Level& fine = levels[k];
+        const Level& coarse = levels[k + 1];
+        const int size = fine.width * fine.height;
+        const Color3* fineFirst = gaussianFirst(k);
+        const Color3* fineSecond = gaussianSecond(k);
+        const float* fineMask = gaussianMask(k);
+        Color3* band = k == 0 ? output : fine.first;
+
+        Expand(coarse.first, coarse.width, coarse.height, expanded, fine.width, fine.height, scratch);
+        #pragma omp parallel for
+        for (int i = 0; i < size; i++)
+        {
+            band[i] = fineFirst[i] - expanded[i];
+        }
+
+        Expand(coarse.second, coarse.width, coarse.height, expanded, fine.width, fine.height, scratch);
+        #pragma omp parallel for
+        for (int i = 0; i < size; i++)
+        {
+            band[i] += fineMask[i] * (fineSecond[i] - expanded[i] - band[i]);
+        }
+    }
+
+    // The coarsest level blends the Gaussians directly
+    const Level& top = levels[count - 1];
+    Color3* topBand = count == 1 ? output : top.first;
+    const Color3* topFirst = gaussianFirst(count - 1);
+    const Color3* topSecond = gaussianSecond(count - 1);
+    const float* topMask = gaussianMask(count - 1);
+    for (int i = 0; i < top.width * top.height; i++)
+    {
+        topBand[i] = topFirst[i] + topMask[i] * (topSecond[i] - topFirst[i]);
+    }
+
+    // Collapse the pyramid
+    for (int k = count - 2; k >= 0; k--)
+    {
+        const Level& fine = levels[k];
+        const Level& coarse = levels[k + 1];
+        const int size = fine.width * fine.height;
+        Color3* band = k == 0 ? output : fine.first;
+
+        Expand(coarse.first, coarse.width, coarse.height, expanded, fine.width, fine.height, scratch);
+        #pragma omp parallel for
+        for (int i = 0; i < size; i++)
+        {
+            band[i] += expanded[i];
+        }
+    }
+}
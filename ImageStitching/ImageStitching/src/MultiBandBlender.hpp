@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Burt-Adelson multi-band blending of two images. Gaussian pyramids of both images and of the blending mask are
+/// built with the separable 5-tap binomial kernel, the Laplacian bands are blended by the mask pyramid and collapsed.
+/// The coarser levels live in one buffer arena kept between calls, so repeated blends of the same size do not allocate.
+/// </summary>
+class MultiBandBlender {
+public:
+
+	MultiBandBlender() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	MultiBandBlender(const MultiBandBlender&) = delete;
+	void operator=(const MultiBandBlender&) = delete;
+	MultiBandBlender(MultiBandBlender&&) = delete;
+	MultiBandBlender& operator=(MultiBandBlender&&) = delete;
+
+	/// <summary>
+	/// Blend two images of the same size.
+	/// </summary>
+	/// <param name="first">first image</param>
+	/// <param name="second">second image</param>
+	/// <param name="mask">weight of the second image at each pixel (0-1)</param>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <param name="levels">number of pyramid levels (0 reduces until the smaller side drops below 16 pixels)</param>
+	/// <param name="output">blended image</param>
+	void Blend(const Color3* first, const Color3* second, const float* mask, int width, int height, int levels, Color3* output);
+
+	/// <summary>
+	/// Return number of levels used by the last blend.
+	/// </summary>
+	/// <returns>number of levels</returns>
+	int Levels();
+
+private:
+
+	/// <summary>
+	/// Buffers of one pyramid level inside the arena.
+	/// </summary>
+	struct Level {
+		int width;
+		int height;
+		Color3* first; // Gaussian, later blended Laplacian band of the first image (null on the finest level)
+		Color3* second; // Gaussian of the second image (null on the finest level)
+		float* mask; // Gaussian of the mask (null on the finest level)
+	};
+
+	/// <summary>
+	/// Compute level sizes and partition the arena, growing it only if it is too small.
+	/// </summary>
+	void Reserve(int width, int height, int levels);
+
+	std::vector<Level> levels; // Pyramid levels, level 0 is the finest
+	std::unique_ptr<Color3[]> colorArena; // Storage of the colour levels and of the scratch buffers
+	std::unique_ptr<float[]> maskArena; // Storage of the mask levels
+	size_t colorCapacity = 0; // Number of Color3 values in the colour arena
+	size_t maskCapacity = 0; // Number of floats in the mask arena
+	Color3* scratch = nullptr; // Intermediate result of the separable filters (finest level size)
+	Color3* expanded = nullptr; // Expanded coarser level (finest level size)
+	float* maskScratch = nullptr; // Intermediate result of the mask filters (finest level size)
+};
@@ -0,0 +1,330 @@
+#include "Panorama.hpp"
+#include <algorithm>
+#include <limits>
+
+#include <GridGraph_2D_4C.h>
+
+// Scale of the colour differences in the integer seam capacities
+const float SEAM_SCALE{ 1000.0f };
+// Capacity of the terminal edges of pixels tied to one image
+const int SEAM_INF{ 1 << 24 };
+
+void Panorama::Add(Image& image, int offsetX, int offsetY)
+{
+    Add(PanoramaImage{ image.DataPtr(), nullptr, image.Width(), image.Height(), offsetX, offsetY });
+}
+
+void Panorama::Add(const PanoramaImage& image)
+{
+    images.push_back(image);
+}
+
+int Panorama::Width()
+{
+    return width;
+}
+
+int Panorama::Height()
+{
+    return height;
+}
+
+int Panorama::Overlaps()
+{
+    return static_cast<int>(overlaps.size());
+}
+
+const int* Panorama::Labels()
+{
+    return labels.data();
+}
+
+bool Panorama::Covers(int image, int x, int y) const
+{
+    const PanoramaImage& img = images[image];
+    const int u = x + originX - img.offsetX;
+    const int v = y + originY - img.offsetY;
+    if (u < 0 || v < 0 || u >= img.width || v >= img.height) return false;
+    return img.mask == nullptr || img.mask[v * img.width + u] != 0;
+}
+
+Color3 Panorama::Sample(int image, int x, int y) const
+{
+    const PanoramaImage& img = images[image];
+    return img.pixels[(y + originY - img.offsetY) * img.width + x + originX - img.offsetX];
+}
+
+void Panorama::FindOverlaps()
+{
+    const int count = static_cast<int>(images.size());
+    overlaps.clear();
+    imageOverlaps.assign(count, std::vector<int>());
+    if (count == 0)
+    {
+        width = height = 0;
+        return;
+    }
+
+    originX = originY = std::numeric_limits<int>::max();
+    int endX = std::numeric_limits<int>::min();
+    int endY = std::numeric_limits<int>::min();
+    for (const PanoramaImage& img : images)
+    {
+        originX = std::min(originX, img.offsetX);
+        originY = std::min(originY, img.offsetY);
+        endX = std::max(endX, img.offsetX + img.width);
+        endY = std::max(endY, img.offsetY + img.height);
+    }
+    width = endX - originX;
+    height = endY - originY;
+
+    // Sweep over the images sorted by their left edge, only images starting before the current one ends can intersect it
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int i, int j) { return images[i].offsetX < images[j].offsetX; });
+
+    for (int k = 0; k < count; k++)
+    {
+        const PanoramaImage& first = images[order[k]];
+        for (int l = k + 1; l < count && images[order[l]].offsetX < first.offsetX + first.width; l++)
+        {
+            const PanoramaImage& second = images[order[l]];
+            const int y0 = std::max(first.offsetY, second.offsetY);
+            const int y1 = std::min(first.offsetY + first.height, second.offsetY + second.height);
+            if (y0 >= y1) continue;
+
+            Overlap overlap;
+            overlap.a = std::min(order[k], order[l]);
+            overlap.b = std::max(order[k], order[l]);
+            overlap.x0 = second.offsetX - originX;
+            overlap.x1 = std::min(first.offsetX + first.width, second.offsetX + second.width) - originX;
+            overlap.y0 = y0 - originY;
+            overlap.y1 = y1 - originY;
+            imageOverlaps[overlap.b].push_back(static_cast<int>(overlaps.size()));
+            overlaps.push_back(std::move(overlap));
+        }
+    }
+}
+
+void Panorama::ComputeSeam(Overlap& overlap)
+{
+    typedef GridGraph_2D_4C<int, int, int> Grid;
+
+    const int w = overlap.x1 - overlap.x0;
+    const int h = overlap.y1 - overlap.y0;
+
+    // Colour difference of both images, -1 where only one of them is valid
+    std::vector<float> difference(w * h);
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            const int x = overlap.x0 + j;
+            const int y = overlap.y0 + i;
+            const bool both = Covers(overlap.a, x, y) && Covers(overlap.b, x, y);
+            difference[i * w + j] = both ? Length(Sample(overlap.a, x, y) - Sample(overlap.b, x, y)) : -1.0f;
+        }
+    }
+
+    // Cutting next to a pixel valid in one image only costs the difference of the other pixel twice
+    auto cost = [&](int p, int q)
+    {
+        const float dp = difference[p];
+        const float dq = difference[q];
+        const float sum = dp < 0 ? std::max(2.0f * dq, 0.0f) : (dq < 0 ? 2.0f * dp : dp + dq);
+        return 1 + static_cast<int>(SEAM_SCALE * sum);
+    };
+
+    // Image valid at a pixel outside the overlap: 1 for a only, 2 for b only, 0 otherwise
+    auto outside = [&](int x, int y)
+    {
+        if (x < 0 || y < 0 || x >= width || y >= height) return 0;
+        const bool a = Covers(overlap.a, x, y);
+        const bool b = Covers(overlap.b, x, y);
+        return a == b ? 0 : (a ? 1 : 2);
+    };
+
+    Grid* grid = new Grid(w, h);
+
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            const int x = overlap.x0 + j;
+            const int y = overlap.y0 + i;
+            bool tieA = false;
+            bool tieB = false;
+            if (difference[i * w + j] < 0)
+            {
+                tieA = Covers(overlap.a, x, y);
+                tieB = Covers(overlap.b, x, y);
+            }
+            else
+            {
+                // Border pixels continue the image that is alone behind the border
+                const int neighbours[4] = {
+                    j == 0 ? outside(x - 1, y) : 0,
+                    j == w - 1 ? outside(x + 1, y) : 0,
+                    i == 0 ? outside(x, y - 1) : 0,
+                    i == h - 1 ? outside(x, y + 1) : 0 };
+                for (int n : neighbours)
+                {
+                    tieA = tieA || n == 1;
+                    tieB = tieB || n == 2;
+                }
+            }
+            grid->set_terminal_cap(grid->node_id(j, i), tieA ? SEAM_INF : 0, tieB ? SEAM_INF : 0);
+
+            if (j < w - 1)
+            {
+                const int cap = cost(i * w + j, i * w + j + 1);
+                grid->set_neighbor_cap(grid->node_id(j, i),      1, 0, cap);
+                grid->set_neighbor_cap(grid->node_id(j + 1, i), -1, 0, cap);
+            }
+
+            if (i < h - 1)
+            {
+                const int cap = cost(i * w + j, (i + 1) * w + j);
+                grid->set_neighbor_cap(grid->node_id(j, i),     0,  1, cap);
+                grid->set_neighbor_cap(grid->node_id(j, i + 1), 0, -1, cap);
+            }
+        }
+    }
+
+    grid->compute_maxflow();
+
+    overlap.seam.resize(w * h);
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            overlap.seam[i * w + j] = static_cast<unsigned char>(grid->get_segment(grid->node_id(j, i)));
+        }
+    }
+
+    delete grid;
+}
+
+void Panorama::ResolveLabels()
+{
+    labels.assign(width * height, -1);
+
+    // Images are laid over each other in priority order, a pixel changes owner where the seam of the overlap selects the new image
+    for (int k = 0; k < static_cast<int>(images.size()); k++)
+    {
+        const PanoramaImage& img = images[k];
+        const int x0 = img.offsetX - originX;
+        const int y0 = img.offsetY - originY;
+
+        #pragma omp parallel for
+        for (int i = y0; i < y0 + img.height; i++)
+        {
+            const Overlap* overlap = nullptr;
+            for (int j = x0; j < x0 + img.width; j++)
+            {
+                if (!Covers(k, j, i)) continue;
+                int& label = labels[i * width + j];
+                if (label < 0)
+                {
+                    label = k;
+                    continue;
+                }
+                if (overlap == nullptr || overlap->a != label)
+                {
+                    for (int index : imageOverlaps[k])
+                    {
+                        if (overlaps[index].a == label) overlap = &overlaps[index];
+                    }
+                }
+                if (overlap->seam[(i - overlap->y0) * (overlap->x1 - overlap->x0) + j - overlap->x0]) label = k;
+            }
+        }
+    }
+}
+
+Color3* Panorama::Compose(const PoissonSettings& settings, SolverStats* stats)
+{
+    FindOverlaps();
+
+    // Overlaps are independent min-cut problems
+    const int overlapCount = static_cast<int>(overlaps.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < overlapCount; k++)
+    {
+        ComputeSeam(overlaps[k]);
+    }
+
+    ResolveLabels();
+
+    Color3* output = new Color3[width * height];
+
+    // Cut-and-paste composite of the selected pixels
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            const int label = labels[i * width + j];
+            output[i * width + j] = label < 0 ? Color3(0.0f) : Sample(label, j, i);
+        }
+    }
+
+    // Guidance gradient from pixel (x, y) to its neighbour (u, v). Across a seam it is taken from the images
+    // valid at both pixels, elsewhere it equals the composite difference.
+    auto guidance = [&](int x, int y, int u, int v)
+    {
+        const int a = labels[y * width + x];
+        const int b = labels[v * width + u];
+        const Color3 difference = output[v * width + u] - output[y * width + x];
+        if (a < 0 || b < 0 || a == b) return difference;
+
+        const bool fromA = Covers(a, u, v);
+        const bool fromB = Covers(b, x, y);
+        const Color3 gradientA = fromA ? Sample(a, u, v) - Sample(a, x, y) : Color3(0.0f);
+        const Color3 gradientB = fromB ? Sample(b, u, v) - Sample(b, x, y) : Color3(0.0f);
+        if (fromA && fromB) return 0.5f * (gradientA + gradientB);
+        if (fromA) return gradientA;
+        if (fromB) return gradientB;
+        return difference;
+    };
+
+    // The correction c of the composite solves A c = sum over neighbours of (composite difference - guidance),
+    // which is non-zero only along the seams. The canvas border keeps the composite values (c = 0).
+    std::unique_ptr<Color3[]> rhs = std::make_unique<Color3[]>(width * height);
+    std::unique_ptr<Color3[]> correction = std::make_unique<Color3[]>(width * height);
+
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            const Color3 value = output[i * width + j];
+            Color3 b(0.0f);
+            if (j > 0) b += output[i * width + j - 1] - value - guidance(j, i, j - 1, i);
+            if (j < width - 1) b += output[i * width + j + 1] - value - guidance(j, i, j + 1, i);
+            if (i > 0) b += output[(i - 1) * width + j] - value - guidance(j, i, j, i - 1);
+            if (i < height - 1) b += output[(i + 1) * width + j] - value - guidance(j, i, j, i + 1);
+            rhs[i * width + j] = b;
+            correction[i * width + j] = Color3(0.0f);
+        }
+    }
+
+    SolverStats solverStats = PoissonSolver::Solve(rhs.get(), correction.get(), width, height, settings);
+    if (stats) *stats = solverStats;
+
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            if (labels[i * width + j] < 0) continue;
+            Color3& pixel = output[i * width + j];
+            pixel += correction[i * width + j];
+            pixel.x = std::clamp(pixel.x, 0.0f, 1.0f);
+            pixel.y = std::clamp(pixel.y, 0.0f, 1.0f);
+            pixel.z = std::clamp(pixel.z, 0.0f, 1.0f);
+        }
+    }
+
+    return output;
+}
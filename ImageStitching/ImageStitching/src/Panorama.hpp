@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Image.hpp"
+#include <vector>
+
+/// <summary>
+/// Image placed on the panorama canvas.
+/// </summary>
+struct PanoramaImage {
+	const Color3* pixels; // Pixels of the image (not owned)
+	const unsigned char* mask; // Non-zero for valid pixels (null marks all pixels valid)
+	int width; // Image width
+	int height; // Image height
+	int offsetX; // Canvas column of the first image column
+	int offsetY; // Canvas row of the first image row
+};
+
+/// <summary>
+/// Compositor of N overlapping images. The source of every canvas pixel is selected by min-cut seams
+/// computed independently for each pair of overlapping images, the seams are then hidden by a Poisson
+/// solve of a correction field on the whole canvas.
+/// </summary>
+class Panorama {
+public:
+
+	Panorama() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	Panorama(const Panorama&) = delete;
+	void operator=(const Panorama&) = delete;
+	Panorama(Panorama&&) = delete;
+	Panorama& operator=(Panorama&&) = delete;
+
+	/// <summary>
+	/// Add original data of an image, the image has to outlive the panorama.
+	/// </summary>
+	/// <param name="image">image</param>
+	/// <param name="offsetX">canvas column of the first image column</param>
+	/// <param name="offsetY">canvas row of the first image row</param>
+	void Add(Image& image, int offsetX, int offsetY);
+
+	/// <summary>
+	/// Add pixel buffer with an optional coverage mask, both have to outlive the panorama.
+	/// Images added earlier have lower priority when the seams are resolved.
+	/// </summary>
+	/// <param name="image">placed image</param>
+	void Add(const PanoramaImage& image);
+
+	/// <summary>
+	/// Compute seams of all overlaps, compose the images and blend them in the gradient domain.
+	/// </summary>
+	/// <param name="settings">solver settings of the correction field</param>
+	/// <param name="stats">optional output of solver statistics</param>
+	/// <returns>panorama of size Width() x Height(), uncovered pixels are black (owned by the caller)</returns>
+	Color3* Compose(const PoissonSettings& settings = PoissonSettings(PoissonMethod::Multigrid), SolverStats* stats = nullptr);
+
+	/// <summary>
+	/// Return width of the canvas.
+	/// </summary>
+	/// <returns>width</returns>
+	int Width();
+
+	/// <summary>
+	/// Return height of the canvas.
+	/// </summary>
+	/// <returns>height</returns>
+	int Height();
+
+	/// <summary>
+	/// Return number of overlapping image pairs found by the last composition.
+	/// </summary>
+	/// <returns>number of overlaps</returns>
+	int Overlaps();
+
+	/// <summary>
+	/// Return index of the image selected for each canvas pixel by the last composition (-1 for uncovered pixels).
+	/// </summary>
+	/// <returns>label array of size Width() x Height()</returns>
+	const int* Labels();
+
+private:
+
+	/// <summary>
+	/// Pair of images with intersecting bounding boxes.
+	/// </summary>
+	struct Overlap {
+		int a; // Lower priority image (source terminal)
+		int b; // Higher priority image (sink terminal)
+		int x0, y0, x1, y1; // Intersection of the bounding boxes in panorama pixels, [x0, x1) x [y0, y1)
+		std::vector<unsigned char> seam; // Non-zero where image b is selected, (x1 - x0) x (y1 - y0)
+	};
+
+	/// <summary>
+	/// Compute canvas bounding box and find overlapping pairs by a sweep over images sorted by their left edge.
+	/// </summary>
+	void FindOverlaps();
+
+	/// <summary>
+	/// Select image of each pixel of an overlap by a min-cut. Pixels covered by one image only are tied to it,
+	/// cutting between two neighbours costs the colour difference of both images at the two pixels.
+	/// </summary>
+	/// <param name="overlap">overlap to process</param>
+	void ComputeSeam(Overlap& overlap);
+
+	/// <summary>
+	/// Resolve label of every canvas pixel from the pairwise seams in the order of the images.
+	/// </summary>
+	void ResolveLabels();
+
+	/// <summary>
+	/// Test whether an image has a valid pixel at a given panorama position.
+	/// </summary>
+	bool Covers(int image, int x, int y) const;
+
+	/// <summary>
+	/// Get pixel of an image at a given panorama position, the position has to be covered.
+	/// </summary>
+	Color3 Sample(int image, int x, int y) const;
+
+	std::vector<PanoramaImage> images; // Placed images in priority order
+	std::vector<Overlap> overlaps; // Overlapping pairs
+	std::vector<std::vector<int>> imageOverlaps; // Overlaps of each image with the images added before it
+	std::vector<int> labels; // Selected image of each canvas pixel
+	int originX = 0; // Canvas position of the first panorama column
+	int originY = 0; // Canvas position of the first panorama row
+	int width = 0; // Panorama width
+	int height = 0; // Panorama height
+};
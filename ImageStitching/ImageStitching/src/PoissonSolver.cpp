@@ -0,0 +1,597 @@
+#include "PoissonSolver.hpp"
+#include "QuadtreeSolver.hpp"
+#include <algorithm>
+
+#include <fftw3.h>
+
+PoissonSolver::PoissonSolver(int width, int height)
+{
+    // Position of the far Dirichlet boundary in node units of the current level, the near one always lies at -1
+    float boundaryX = static_cast<float>(width);
+    float boundaryY = static_cast<float>(height);
+    int w = width;
+    int h = height;
+    while (true)
+    {
+        Level level;
+        level.width = w;
+        level.height = h;
+        level.edgeX = 1.0f / (boundaryX - (w - 1)) - 1.0f;
+        level.edgeY = 1.0f / (boundaryY - (h - 1)) - 1.0f;
+        level.x = std::make_unique<Color3[]>(w * h);
+        level.rhs = std::make_unique<Color3[]>(w * h);
+        level.residual = std::make_unique<Color3[]>(w * h);
+        levels.push_back(std::move(level));
+
+        if (w <= 4 || h <= 4) break;
+
+        // Coarse node c lies at fine node 2c + 1, the last coarse node is kept between 0.5 and 1.5 nodes from the boundary
+        boundaryX = (boundaryX - 1.0f) * 0.5f;
+        boundaryY = (boundaryY - 1.0f) * 0.5f;
+        int coarseWidth = static_cast<int>(std::floor(boundaryX - 0.5f)) + 1;
+        int coarseHeight = static_cast<int>(std::floor(boundaryY - 0.5f)) + 1;
+        BuildWeights(w, coarseWidth, boundaryX, levels.back().prolongX, levels.back().restrictX);
+        BuildWeights(h, coarseHeight, boundaryY, levels.back().prolongY, levels.back().restrictY);
+        w = coarseWidth;
+        h = coarseHeight;
+    }
+}
+
+SolverStats PoissonSolver::Solve(const Color3* rhs, Color3* x, int width, int height, const PoissonSettings& settings)
+{
+    switch (settings.method)
+    {
+    case PoissonMethod::Jacobi:
+        return Jacobi(rhs, x, width, height, settings.iterations, settings.tolerance, settings.checkInterval);
+    case PoissonMethod::SOR:
+        return SOR(rhs, x, width, height, settings.iterations, settings.tolerance, settings.checkInterval, settings.omega);
+    case PoissonMethod::Direct:
+    {
+        Direct(rhs, x, width, height);
+        SolverStats stats;
+        stats.residual = RelativeResidual(rhs, x, width, height);
+        return stats;
+    }
+    case PoissonMethod::ConjugateGradient:
+        return PoissonSolver(width, height).ConjugateGradient(rhs, x, settings.iterations, settings.tolerance, settings.preconditioner);
+    case PoissonMethod::FullMultigrid:
+        return PoissonSolver(width, height).FullMultigrid(rhs, x, settings.cycles, settings.tolerance);
+    case PoissonMethod::Quadtree:
+        return QuadtreeSolver::Solve(rhs, x, width, height, settings.iterations, settings.tolerance, settings.quadtreeThreshold);
+    default:
+        return PoissonSolver(width, height).Multigrid(rhs, x, settings.cycles, settings.tolerance);
+    }
+}
+
+SolverStats PoissonSolver::Jacobi(const Color3* rhs, Color3* x, int width, int height, int iterations, float tolerance, int checkInterval)
+{
+    checkInterval = std::max(checkInterval, 1);
+    std::unique_ptr<Color3[]> tmp = std::make_unique<Color3[]>(width * height);
+    Color3* current = x;
+    Color3* next = tmp.get();
+    SolverStats stats;
+
+    while (stats.iterations < iterations)
+    {
+        #pragma omp parallel for
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                Color3 sum = rhs[i * width + j];
+                if (i > 0) sum += current[(i - 1) * width + j];
+                if (i + 1 < height) sum += current[(i + 1) * width + j];
+                if (j > 0) sum += current[i * width + j - 1];
+                if (j + 1 < width) sum += current[i * width + j + 1];
+                next[i * width + j] = sum * 0.25f;
+            }
+        }
+        std::swap(current, next);
+        stats.iterations++;
+
+        if (tolerance > 0.0f && stats.iterations % checkInterval == 0)
+        {
+            if (RelativeResidual(rhs, current, width, height) <= tolerance) break;
+        }
+    }
+
+    if (current != x)
+    {
+        std::copy(current, current + width * height, x);
+    }
+    stats.residual = RelativeResidual(rhs, x, width, height);
+    return stats;
+}
+
+SolverStats PoissonSolver::SOR(const Color3* rhs, Color3* x, int width, int height, int iterations, float tolerance, int checkInterval, float omega)
+{
+    if (omega <= 0.0f) omega = OptimalOmega(width, height);
+    checkInterval = std::max(checkInterval, 1);
+    const float factor = 0.25f * omega;
+    SolverStats stats;
+
+    while (stats.iterations < iterations)
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            // Every thread updates a contiguous band of rows, pixels of one colour only read the other colour
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < height; i++)
+            {
+                Color3* row = x + i * width;
+                const Color3* rhsRow = rhs + i * width;
+                const Color3* up = i > 0 ? row - width : nullptr;
+                const Color3* down = i + 1 < height ? row + width : nullptr;
+
+                for (int j = (i + color) & 1; j < width; j += 2)
+                {
+                    Color3 sum = rhsRow[j] - 4.0f * row[j];
+                    if (up) sum += up[j];
+                    if (down) sum += down[j];
+                    if (j > 0) sum += row[j - 1];
+                    if (j + 1 < width) sum += row[j + 1];
+                    row[j] += factor * sum;
+                }
+            }
+        }
+        stats.iterations++;
+
+        if (tolerance > 0.0f && stats.iterations % checkInterval == 0)
+        {
+            if (RelativeResidual(rhs, x, width, height) <= tolerance) break;
+        }
+    }
+
+    stats.residual = RelativeResidual(rhs, x, width, height);
+    return stats;
+}
+
+float PoissonSolver::OptimalOmega(int width, int height)
+{
+    const double pi = 3.14159265358979323846;
+    double rho = 0.5 * (std::cos(pi / (width + 1)) + std::cos(pi / (height + 1)));
+    return static_cast<float>(2.0 / (1.0 + std::sqrt(1.0 - rho * rho)));
+}
+
+SolverStats PoissonSolver::Multigrid(const Color3* rhs, Color3* x, int cycles, float tolerance)
+{
+    Level& finest = levels[0];
+    std::copy(rhs, rhs + finest.width * finest.height, finest.rhs.get());
+    std::copy(x, x + finest.width * finest.height, finest.x.get());
+
+    SolverStats stats;
+    while (stats.iterations < cycles)
+    {
+        VCycle(0);
+        stats.iterations++;
+        if (tolerance > 0.0f && RelativeResidual(rhs, finest.x.get(), finest.width, finest.height) <= tolerance) break;
+    }
+
+    std::copy(finest.x.get(), finest.x.get() + finest.width * finest.height, x);
+    stats.residual = RelativeResidual(rhs, x, finest.width, finest.height);
+    return stats;
+}
+
+SolverStats PoissonSolver::FullMultigrid(const Color3* rhs, Color3* x, int cycles, float tolerance)
+{
+    Level& finest = levels[0];
+    std::copy(rhs, rhs + finest.width * finest.height, finest.rhs.get());
+
+    // Transfer right-hand side to all levels
+    for (int l = 0; l + 1 < static_cast<int>(levels.size()); l++)
+    {
+        Restrict(l, levels[l].rhs.get());
+    }
+
+    // Solve on the coarsest level and refine the solution level by level
+    Level& coarsest = levels.back();
+    std::fill(coarsest.x.get(), coarsest.x.get() + coarsest.width * coarsest.height, 0.0f);
+    SolveCoarsest();
+    for (int l = static_cast<int>(levels.size()) - 2; l >= 0; l--)
+    {
+        std::fill(levels[l].x.get(), levels[l].x.get() + levels[l].width * levels[l].height, 0.0f);
+        Prolongate(l);
+        VCycle(l);
+    }
+
+    SolverStats stats;
+    while (stats.iterations < cycles)
+    {
+        if (tolerance > 0.0f && RelativeResidual(rhs, finest.x.get(), finest.width, finest.height) <= tolerance) break;
+        VCycle(0);
+        stats.iterations++;
+    }
+
+    std::copy(finest.x.get(), finest.x.get() + finest.width * finest.height, x);
+    stats.residual = RelativeResidual(rhs, x, finest.width, finest.height);
+    return stats;
+}
+
+SolverStats PoissonSolver::ConjugateGradient(const Color3* rhs, Color3* x, int iterations, float tolerance, Preconditioner preconditioner)
+{
+    const int w = levels[0].width;
+    const int h = levels[0].height;
+    std::unique_ptr<Color3[]> r = std::make_unique<Color3[]>(w * h);
+    std::unique_ptr<Color3[]> z = std::make_unique<Color3[]>(w * h);
+    std::unique_ptr<Color3[]> p = std::make_unique<Color3[]>(w * h);
+    std::unique_ptr<Color3[]> q = std::make_unique<Color3[]>(w * h);
+
+    // Per-channel quotient, channels that already converged exactly stop moving
+    auto divide = [](const Color3& a, const Color3& b)
+    {
+        return Color3(b.x != 0.0f ? a.x / b.x : 0.0f, b.y != 0.0f ? a.y / b.y : 0.0f, b.z != 0.0f ? a.z / b.z : 0.0f);
+    };
+
+    auto precondition = [&]()
+    {
+        if (preconditioner == Preconditioner::Multigrid)
+        {
+            Level& finest = levels[0];
+            std::copy(r.get(), r.get() + w * h, finest.rhs.get());
+            std::fill(finest.x.get(), finest.x.get() + w * h, 0.0f);
+            VCycle(0);
+            std::copy(finest.x.get(), finest.x.get() + w * h, z.get());
+        }
+        else
+        {
+            // The diagonal of A is constant
+            const float scale = preconditioner == Preconditioner::Jacobi ? 0.25f : 1.0f;
+            #pragma omp parallel for
+            for (int i = 0; i < w * h; i++)
+            {
+                z[i] = r[i] * scale;
+            }
+        }
+    };
+
+    // r = b - A x, |b|^2
+    double rhsSum = 0.0;
+    #pragma omp parallel for reduction(+:rhsSum)
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            Color3 res = rhs[i * w + j] - 4.0f * x[i * w + j];
+            if (i > 0) res += x[(i - 1) * w + j];
+            if (i + 1 < h) res += x[(i + 1) * w + j];
+            if (j > 0) res += x[i * w + j - 1];
+            if (j + 1 < w) res += x[i * w + j + 1];
+            r[i * w + j] = res;
+            rhsSum += SquaredLength(rhs[i * w + j]);
+        }
+    }
+    const double rhsNorm = rhsSum > 0.0 ? std::sqrt(rhsSum) : 1.0;
+
+    precondition();
+    std::copy(z.get(), z.get() + w * h, p.get());
+    double rzx = 0.0, rzy = 0.0, rzz = 0.0;
+    #pragma omp parallel for reduction(+:rzx, rzy, rzz)
+    for (int i = 0; i < w * h; i++)
+    {
+        rzx += r[i].x * z[i].x;
+        rzy += r[i].y * z[i].y;
+        rzz += r[i].z * z[i].z;
+    }
+    Color3 rz(static_cast<float>(rzx), static_cast<float>(rzy), static_cast<float>(rzz));
+
+    SolverStats stats;
+    while (stats.iterations < iterations)
+    {
+        // q = A p, p.q
+        double pqx = 0.0, pqy = 0.0, pqz = 0.0;
+        #pragma omp parallel for reduction(+:pqx, pqy, pqz)
+        for (int i = 0; i < h; i++)
+        {
+            for (int j = 0; j < w; j++)
+            {
+                Color3 ap = 4.0f * p[i * w + j];
+                if (i > 0) ap -= p[(i - 1) * w + j];
+                if (i + 1 < h) ap -= p[(i + 1) * w + j];
+                if (j > 0) ap -= p[i * w + j - 1];
+                if (j + 1 < w) ap -= p[i * w + j + 1];
+                q[i * w + j] = ap;
+                pqx += p[i * w + j].x * ap.x;
+                pqy += p[i * w + j].y * ap.y;
+                pqz += p[i * w + j].z * ap.z;
+            }
+        }
+        Color3 alpha = divide(rz, Color3(static_cast<float>(pqx), static_cast<float>(pqy), static_cast<float>(pqz)));
+
+        // x += alpha p, r -= alpha q, |r|^2
+        double residualSum = 0.0;
+        #pragma omp parallel for reduction(+:residualSum)
+        for (int i = 0; i < w * h; i++)
+        {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            residualSum += SquaredLength(r[i]);
+        }
+        stats.iterations++;
+        stats.residual = static_cast<float>(std::sqrt(residualSum) / rhsNorm);
+        stats.history.push_back(stats.residual);
+        if (tolerance > 0.0f && stats.residual <= tolerance) break;
+
+        precondition();
+        rzx = rzy = rzz = 0.0;
+        #pragma omp parallel for reduction(+:rzx, rzy, rzz)
+        for (int i = 0; i < w * h; i++)
+        {
+            rzx += r[i].x * z[i].x;
+            rzy += r[i].y * z[i].y;
+            rzz += r[i].z * z[i].z;
+        }
+        Color3 rzNew(static_cast<float>(rzx), static_cast<float>(rzy), static_cast<float>(rzz));
+        Color3 beta = divide(rzNew, rz);
+        rz = rzNew;
+
+        #pragma omp parallel for
+        for (int i = 0; i < w * h; i++)
+        {
+            p[i] = z[i] + beta * p[i];
+        }
+    }
+
+    // The recursively updated residual drifts from the true one in single precision
+    stats.residual = RelativeResidual(rhs, x, w, h);
+    return stats;
+}
+
+void PoissonSolver::Direct(const Color3* rhs, Color3* x, int width, int height)
+{
+    double* in = fftw_alloc_real(width * height);
+    double* out = fftw_alloc_real(width * height);
+
+    // RODFT00 is its own inverse up to the scale 2 (n + 1) per dimension
+    fftw_plan planFwd = fftw_plan_r2r_2d(height, width, in, out, FFTW_RODFT00, FFTW_RODFT00, FFTW_ESTIMATE);
+    fftw_plan planBck = fftw_plan_r2r_2d(height, width, out, in, FFTW_RODFT00, FFTW_RODFT00, FFTW_ESTIMATE);
+    const double scale = 1.0 / (4.0 * (width + 1) * (height + 1));
+
+    // Eigenvalues of the 1D operators
+    const double pi = 3.14159265358979323846;
+    std::vector<double> eigenX(width);
+    std::vector<double> eigenY(height);
+    for (int j = 0; j < width; j++)
+    {
+        eigenX[j] = 2.0 - 2.0 * std::cos(pi * (j + 1) / (width + 1));
+    }
+    for (int i = 0; i < height; i++)
+    {
+        eigenY[i] = 2.0 - 2.0 * std::cos(pi * (i + 1) / (height + 1));
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        for (int i = 0; i < width * height; i++)
+        {
+            in[i] = rhs[i][c];
+        }
+
+        fftw_execute(planFwd);
+
+        #pragma omp parallel for
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                out[i * width + j] *= scale / (eigenX[j] + eigenY[i]);
+            }
+        }
+
+        fftw_execute(planBck);
+
+        for (int i = 0; i < width * height; i++)
+        {
+            x[i][c] = static_cast<float>(in[i]);
+        }
+    }
+
+    fftw_destroy_plan(planFwd);
+    fftw_destroy_plan(planBck);
+    fftw_free(in);
+    fftw_free(out);
+    fftw_cleanup();
+}
+
+float PoissonSolver::RelativeResidual(const Color3* rhs, const Color3* x, int width, int height)
+{
+    double residualSum = 0.0;
+    double rhsSum = 0.0;
+
+    #pragma omp parallel for reduction(+:residualSum, rhsSum)
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            Color3 r = rhs[i * width + j] - 4.0f * x[i * width + j];
+            if (i > 0) r += x[(i - 1) * width + j];
+            if (i + 1 < height) r += x[(i + 1) * width + j];
+            if (j > 0) r += x[i * width + j - 1];
+            if (j + 1 < width) r += x[i * width + j + 1];
+            residualSum += SquaredLength(r);
+            rhsSum += SquaredLength(rhs[i * width + j]);
+        }
+    }
+
+    return static_cast<float>(rhsSum > 0.0 ? std::sqrt(residualSum / rhsSum) : std::sqrt(residualSum));
+}
+
+int PoissonSolver::Levels()
+{
+    return static_cast<int>(levels.size());
+}
+
+void PoissonSolver::VCycle(int level)
+{
+    if (level + 1 == static_cast<int>(levels.size()))
+    {
+        SolveCoarsest();
+        return;
+    }
+
+    Level& fine = levels[level];
+    Level& coarse = levels[level + 1];
+
+    Smooth(level, preSmoothing);
+
+    // Coarse grid correction
+    ComputeResidual(level);
+    Restrict(level, fine.residual.get());
+    std::fill(coarse.x.get(), coarse.x.get() + coarse.width * coarse.height, 0.0f);
+    VCycle(level + 1);
+    Prolongate(level);
+
+    // Reversed order keeps the V-cycle symmetric, as required by the conjugate gradient preconditioner
+    Smooth(level, postSmoothing, true);
+}
+
+void PoissonSolver::Smooth(int level, int sweeps, bool reverse)
+{
+    const int w = levels[level].width;
+    const int h = levels[level].height;
+    const float edgeX = levels[level].edgeX;
+    const float edgeY = levels[level].edgeY;
+    Color3* x = levels[level].x.get();
+    const Color3* rhs = levels[level].rhs.get();
+
+    for (int sweep = 0; sweep < sweeps; sweep++)
+    {
+        // Pixels of one colour depend only on pixels of the other colour, so rows can be updated in parallel
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const int color = reverse ? 1 - pass : pass;
+            #pragma omp parallel for
+            for (int i = 0; i < h; i++)
+            {
+                for (int j = (i + color) & 1; j < w; j += 2)
+                {
+                    Color3 sum = rhs[i * w + j];
+                    if (i > 0) sum += x[(i - 1) * w + j];
+                    if (i + 1 < h) sum += x[(i + 1) * w + j];
+                    if (j > 0) sum += x[i * w + j - 1];
+                    if (j + 1 < w) sum += x[i * w + j + 1];
+                    float diagonal = 4.0f + (j + 1 == w ? edgeX : 0.0f) + (i + 1 == h ? edgeY : 0.0f);
+                    x[i * w + j] = sum / diagonal;
+                }
+            }
+        }
+    }
+}
+
+void PoissonSolver::SolveCoarsest()
+{
+    // At least one side of the coarsest grid has at most 4 nodes, which bounds the convergence rate
+    Smooth(static_cast<int>(levels.size()) - 1, 100);
+}
+
+void PoissonSolver::ComputeResidual(int level)
+{
+    const int w = levels[level].width;
+    const int h = levels[level].height;
+    const float edgeX = levels[level].edgeX;
+    const float edgeY = levels[level].edgeY;
+    const Color3* x = levels[level].x.get();
+    const Color3* rhs = levels[level].rhs.get();
+    Color3* residual = levels[level].residual.get();
+
+    #pragma omp parallel for
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            float diagonal = 4.0f + (j + 1 == w ? edgeX : 0.0f) + (i + 1 == h ? edgeY : 0.0f);
+            Color3 r = rhs[i * w + j] - diagonal * x[i * w + j];
+            if (i > 0) r += x[(i - 1) * w + j];
+            if (i + 1 < h) r += x[(i + 1) * w + j];
+            if (j > 0) r += x[i * w + j - 1];
+            if (j + 1 < w) r += x[i * w + j + 1];
+            residual[i * w + j] = r;
+        }
+    }
+}
+
+void PoissonSolver::Restrict(int level, const Color3* fine)
+{
+    // Transpose of the prolongation, i.e. full weighting scaled by 4 as the grid spacing doubles
+    const Level& f = levels[level];
+    Level& c = levels[level + 1];
+
+    #pragma omp parallel for
+    for (int ci = 0; ci < c.height; ci++)
+    {
+        const Weights& wi = f.restrictY[ci];
+        for (int cj = 0; cj < c.width; cj++)
+        {
+            const Weights& wj = f.restrictX[cj];
+            Color3 sum(0.0f);
+            for (int a = 0; a < wi.count; a++)
+            {
+                for (int b = 0; b < wj.count; b++)
+                {
+                    sum += fine[wi.index[a] * f.width + wj.index[b]] * (wi.weight[a] * wj.weight[b]);
+                }
+            }
+            c.rhs[ci * c.width + cj] = sum;
+        }
+    }
+}
+
+void PoissonSolver::Prolongate(int level)
+{
+    Level& f = levels[level];
+    const Level& c = levels[level + 1];
+
+    #pragma omp parallel for
+    for (int fi = 0; fi < f.height; fi++)
+    {
+        const Weights& wi = f.prolongY[fi];
+        for (int fj = 0; fj < f.width; fj++)
+        {
+            const Weights& wj = f.prolongX[fj];
+            Color3 sum(0.0f);
+            for (int a = 0; a < wi.count; a++)
+            {
+                for (int b = 0; b < wj.count; b++)
+                {
+                    sum += c.x[wi.index[a] * c.width + wj.index[b]] * (wi.weight[a] * wj.weight[b]);
+                }
+            }
+            f.x[fi * f.width + fj] += sum;
+        }
+    }
+}
+
+void PoissonSolver::BuildWeights(int fineCount, int coarseCount, float coarseBoundary, std::vector<Weights>& prolongation, std::vector<Weights>& restriction)
+{
+    prolongation.assign(fineCount, Weights());
+    restriction.assign(coarseCount, Weights());
+    const int last = coarseCount - 1;
+
+    auto add = [&](int f, int c, float weight)
+    {
+        if (c < 0 || c > last || weight <= 0.0f) return;
+        Weights& p = prolongation[f];
+        p.index[p.count] = c;
+        p.weight[p.count++] = weight;
+        Weights& r = restriction[c];
+        r.index[r.count] = f;
+        r.weight[r.count++] = weight;
+    };
+
+    for (int f = 0; f < fineCount; f++)
+    {
+        // Fine node position in coarse node units
+        float q = (f - 1) * 0.5f;
+        if (q > last)
+        {
+            // Interpolate between the last coarse node and the boundary
+            if (q < coarseBoundary) add(f, last, (coarseBoundary - q) / (coarseBoundary - last));
+        }
+        else
+        {
+            int lo = static_cast<int>(std::floor(q));
+            float t = q - lo;
+            add(f, lo, 1.0f - t);
+            add(f, lo + 1, t);
+        }
+    }
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Method used to solve the Poisson equation of the gradient-domain reconstruction.
+/// </summary>
+enum class PoissonMethod {
+	Jacobi, // Jacobi sweeps
+	SOR, // In-place red-black successive over-relaxation
+	ConjugateGradient, // Preconditioned conjugate gradient
+	Multigrid, // Geometric multigrid V-cycles starting from zero
+	FullMultigrid, // Full multigrid (FMG) followed by V-cycles
+	Direct, // Exact solve by the discrete sine transform (FFTW)
+	Quadtree // Conjugate gradient on a quadtree-adaptive correction of the cut-and-paste composite
+};
+
+/// <summary>
+/// Preconditioner of the conjugate gradient solver.
+/// </summary>
+enum class Preconditioner {
+	None, // Plain conjugate gradient
+	Jacobi, // Diagonal scaling
+	Multigrid // One symmetric multigrid V-cycle
+};
+
+/// <summary>
+/// Settings of the Poisson solve.
+/// </summary>
+struct PoissonSettings {
+	PoissonSettings(PoissonMethod method = PoissonMethod::Jacobi) : method(method) {}
+
+	PoissonMethod method; // Solver
+	int iterations = 100000; // Maximum number of sweeps of the Jacobi and SOR solvers or of conjugate gradient iterations
+	int cycles = 6; // Maximum number of V-cycles of the multigrid solvers
+	int checkInterval = 100; // Number of Jacobi or SOR sweeps between two residual evaluations, values below 1 are treated as 1
+	float omega = 0.0f; // Over-relaxation factor of SOR (0 picks the optimal one for the grid size)
+	Preconditioner preconditioner = Preconditioner::Multigrid; // Preconditioner of the conjugate gradient solver
+	float tolerance = 0.0f; // Relative residual at which iterative solvers stop (0 runs all iterations)
+	bool warmStart = false; // Start from the cut-and-paste composite instead of zeros
+	int band = 0; // Half-width of the solved band around the seam, pixels outside keep their source values (0 solves the whole image)
+	float quadtreeThreshold = 1e-4f; // Residual of the composite above which the quadtree solver refines to single pixels
+};
+
+/// <summary>
+/// Statistics of a finished Poisson solve.
+/// </summary>
+struct SolverStats {
+	int iterations = 0; // Number of performed sweeps or V-cycles
+	float residual = 0.0f; // Final relative residual |b - A x| / |b|
+	std::vector<float> history; // Relative residual after every iteration (conjugate gradient only)
+	int unknowns = 0; // Number of unknowns of the reduced or masked system (quadtree and masked solvers only)
+};
+
+/// <summary>
+/// Solver of the discrete Poisson equation A u = b on a regular grid.
+/// A is the 5-point Laplacian (4 u - sum of the four neighbours) with homogeneous Dirichlet boundary,
+/// inhomogeneous boundary values have to be folded into the right-hand side b by the caller.
+/// </summary>
+class PoissonSolver {
+public:
+
+	/// <summary>
+	/// Create solver for a grid of a given size and allocate the multigrid hierarchy.
+	/// </summary>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	PoissonSolver(int width, int height);
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	PoissonSolver(const PoissonSolver&) = delete;
+	void operator=(const PoissonSolver&) = delete;
+	PoissonSolver(PoissonSolver&&) = delete;
+	PoissonSolver& operator=(PoissonSolver&&) = delete;
+
+	/// <summary>
+	/// Solve the equation with the method given by the settings starting from the initial guess stored in x.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">initial guess, overwritten by the solution</param>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	/// <param name="settings">solver settings</param>
+	/// <returns>solver statistics</returns>
+	static SolverStats Solve(const Color3* rhs, Color3* x, int width, int height, const PoissonSettings& settings);
+
+	/// <summary>
+	/// Run Jacobi sweeps starting from the initial guess stored in x until the relative residual drops below a tolerance.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">initial guess, overwritten by the solution</param>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	/// <param name="iterations">maximum number of sweeps</param>
+	/// <param name="tolerance">relative residual tolerance (0 runs all sweeps)</param>
+	/// <param name="checkInterval">number of sweeps between residual evaluations, at least 1</param>
+	/// <returns>number of sweeps and final residual</returns>
+	static SolverStats Jacobi(const Color3* rhs, Color3* x, int width, int height, int iterations, float tolerance = 0.0f, int checkInterval = 100);
+
+	/// <summary>
+	/// Run red-black successive over-relaxation sweeps in place starting from the initial guess stored in x
+	/// until the relative residual drops below a tolerance.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">initial guess, overwritten by the solution</param>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	/// <param name="iterations">maximum number of sweeps</param>
+	/// <param name="tolerance">relative residual tolerance (0 runs all sweeps)</param>
+	/// <param name="checkInterval">number of sweeps between residual evaluations, at least 1</param>
+	/// <param name="omega">over-relaxation factor in (0, 2), 0 picks the optimal factor of the grid</param>
+	/// <returns>number of sweeps and final residual</returns>
+	static SolverStats SOR(const Color3* rhs, Color3* x, int width, int height, int iterations, float tolerance = 0.0f, int checkInterval = 100, float omega = 0.0f);
+
+	/// <summary>
+	/// Return the optimal SOR over-relaxation factor of a grid, 2 / (1 + sqrt(1 - rho^2)) where rho is the spectral radius of the Jacobi iteration.
+	/// </summary>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	/// <returns>over-relaxation factor</returns>
+	static float OptimalOmega(int width, int height);
+
+	/// <summary>
+	/// Run V-cycles starting from the initial guess stored in x until the relative residual drops below a tolerance.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">initial guess, overwritten by the solution</param>
+	/// <param name="cycles">maximum number of V-cycles</param>
+	/// <param name="tolerance">relative residual tolerance (0 runs all cycles)</param>
+	/// <returns>number of V-cycles and final residual</returns>
+	SolverStats Multigrid(const Color3* rhs, Color3* x, int cycles, float tolerance = 0.0f);
+
+	/// <summary>
+	/// Solve the equation with full multigrid (coarse-to-fine V-cycles), followed by additional V-cycles.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">solution</param>
+	/// <param name="cycles">maximum number of V-cycles on the finest level after FMG</param>
+	/// <param name="tolerance">relative residual tolerance (0 runs all cycles)</param>
+	/// <returns>number of V-cycles after FMG and final residual</returns>
+	SolverStats FullMultigrid(const Color3* rhs, Color3* x, int cycles, float tolerance = 0.0f);
+
+	/// <summary>
+	/// Run preconditioned conjugate gradient iterations starting from the initial guess stored in x until the relative residual drops below a tolerance.
+	/// The three channels are independent systems, they are iterated together with separate step lengths.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">initial guess, overwritten by the solution</param>
+	/// <param name="iterations">maximum number of iterations</param>
+	/// <param name="tolerance">relative residual tolerance (0 runs all iterations)</param>
+	/// <param name="preconditioner">preconditioner</param>
+	/// <returns>number of iterations, final residual and residual history</returns>
+	SolverStats ConjugateGradient(const Color3* rhs, Color3* x, int iterations, float tolerance = 0.0f, Preconditioner preconditioner = Preconditioner::Multigrid);
+
+	/// <summary>
+	/// Solve the equation exactly. The eigenvectors of A are products of the discrete sine transform (DST-I) basis functions,
+	/// so the solution is obtained by a forward transform, division by the eigenvalues and an inverse transform.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">solution</param>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	static void Direct(const Color3* rhs, Color3* x, int width, int height);
+
+	/// <summary>
+	/// Compute relative L2 norm of the residual |b - A x| / |b|.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">current solution</param>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	/// <returns>relative residual norm</returns>
+	static float RelativeResidual(const Color3* rhs, const Color3* x, int width, int height);
+
+	/// <summary>
+	/// Return number of levels of the multigrid hierarchy.
+	/// </summary>
+	/// <returns>number of levels</returns>
+	int Levels();
+
+private:
+
+	/// <summary>
+	/// Interpolation weights of one grid line between two levels.
+	/// </summary>
+	struct Weights {
+		int count = 0; // Number of used entries
+		int index[6]; // Indices of nodes on the other level
+		float weight[6]; // Corresponding weights
+	};
+
+	/// <summary>
+	/// Grid of one level of the multigrid hierarchy.
+	/// </summary>
+	struct Level {
+		int width;
+		int height;
+		float edgeX; // Extra diagonal term of the last column (Dirichlet boundary closer than one node)
+		float edgeY; // Extra diagonal term of the last row
+		std::unique_ptr<Color3[]> x; // Solution (correction on coarse levels)
+		std::unique_ptr<Color3[]> rhs; // Right-hand side
+		std::unique_ptr<Color3[]> residual; // Residual b - A x
+		std::vector<Weights> prolongX; // Coarse columns contributing to each column of this level
+		std::vector<Weights> prolongY; // Coarse rows contributing to each row of this level
+		std::vector<Weights> restrictX; // Columns of this level contributing to each coarse column
+		std::vector<Weights> restrictY; // Rows of this level contributing to each coarse row
+	};
+
+	/// <summary>
+	/// Recursive V-cycle on a given level.
+	/// </summary>
+	void VCycle(int level);
+
+	/// <summary>
+	/// Red-black Gauss-Seidel sweeps on a given level, reversed sweeps update black pixels first.
+	/// </summary>
+	void Smooth(int level, int sweeps, bool reverse = false);
+
+	/// <summary>
+	/// Solve the coarsest level by Gauss-Seidel sweeps.
+	/// </summary>
+	void SolveCoarsest();
+
+	/// <summary>
+	/// Compute residual of a given level into its residual buffer.
+	/// </summary>
+	void ComputeResidual(int level);
+
+	/// <summary>
+	/// Restrict residual of a given level to the right-hand side of the next coarser level.
+	/// </summary>
+	void Restrict(int level, const Color3* fine);
+
+	/// <summary>
+	/// Interpolate solution of the next coarser level and add it to a given level.
+	/// </summary>
+	void Prolongate(int level);
+
+	/// <summary>
+	/// Build linear interpolation weights between fine and coarse grid lines, coarse node c lies at fine node 2c + 1.
+	/// </summary>
+	/// <param name="fineCount">number of fine nodes</param>
+	/// <param name="coarseCount">number of coarse nodes</param>
+	/// <param name="coarseBoundary">position of the far Dirichlet boundary in coarse node units</param>
+	/// <param name="prolongation">coarse weights of each fine node</param>
+	/// <param name="restriction">fine weights of each coarse node</param>
+	static void BuildWeights(int fineCount, int coarseCount, float coarseBoundary, std::vector<Weights>& prolongation, std::vector<Weights>& restriction);
+
+	int preSmoothing = 2; // Number of smoothing sweeps before restriction
+	int postSmoothing = 2; // Number of smoothing sweeps after prolongation
+	std::vector<Level> levels; // Multigrid hierarchy, level 0 is the finest
+};
@@ -0,0 +1,419 @@
+#include "QuadtreeSolver.hpp"
+#include <algorithm>
+
+// Distance from the marked pixels, in multiples of the cell size, within which cells are split
+const int GRADING{ 1 };
+
+QuadtreeSolver::QuadtreeSolver(int width, int height) : width(width), height(height)
+{
+    side = 1;
+    while (side < std::max(width, height)) side *= 2;
+}
+
+void QuadtreeSolver::Build(const std::vector<int>& marks)
+{
+    // Marked pixel within one cell size of the cell, this grades the leaves to grow with the distance from the marks
+    auto marked = [&](const Cell& cell)
+    {
+        const int x0 = std::max(cell.x - GRADING * cell.size, 0);
+        const int y0 = std::max(cell.y - GRADING * cell.size, 0);
+        const int x1 = std::min(cell.x + (GRADING + 1) * cell.size, width);
+        const int y1 = std::min(cell.y + (GRADING + 1) * cell.size, height);
+        if (x0 >= x1 || y0 >= y1) return false;
+        const int stride = width + 1;
+        return marks[y1 * stride + x1] - marks[y0 * stride + x1] - marks[y1 * stride + x0] + marks[y0 * stride + x0] > 0;
+    };
+
+    cells.clear();
+    cells.push_back(Cell{ 0, 0, side, -1 });
+    for (int k = 0; k < static_cast<int>(cells.size()); k++)
+    {
+        const Cell cell = cells[k];
+        if (cell.size == 1 || !marked(cell))
+        {
+            leaves.push_back(k);
+            continue;
+        }
+        const int half = cell.size / 2;
+        cells[k].child = static_cast<int>(cells.size());
+        cells.push_back(Cell{ cell.x, cell.y, half, -1 });
+        cells.push_back(Cell{ cell.x + half, cell.y, half, -1 });
+        cells.push_back(Cell{ cell.x, cell.y + half, half, -1 });
+        cells.push_back(Cell{ cell.x + half, cell.y + half, half, -1 });
+    }
+
+    for (int leaf : leaves)
+    {
+        const Cell& cell = cells[leaf];
+        leafCorners.push_back(Corner(cell.x, cell.y));
+        leafCorners.push_back(Corner(cell.x + cell.size, cell.y));
+        leafCorners.push_back(Corner(cell.x, cell.y + cell.size));
+        leafCorners.push_back(Corner(cell.x + cell.size, cell.y + cell.size));
+    }
+}
+
+int QuadtreeSolver::FindLeaf(int x, int y) const
+{
+    int k = 0;
+    while (cells[k].child >= 0)
+    {
+        const Cell& cell = cells[k];
+        const int half = cell.size / 2;
+        k = cell.child + (x >= cell.x + half ? 1 : 0) + (y >= cell.y + half ? 2 : 0);
+    }
+    return k;
+}
+
+int QuadtreeSolver::Corner(int x, int y)
+{
+    const long long key = static_cast<long long>(y) * (side + 1) + x;
+    auto found = cornerIndex.find(key);
+    if (found != cornerIndex.end()) return found->second;
+    const int index = static_cast<int>(cornerKeys.size());
+    cornerIndex[key] = index;
+    cornerKeys.push_back(key);
+    return index;
+}
+
+const std::vector<QuadtreeSolver::Weight>& QuadtreeSolver::Resolve(int corner)
+{
+    if (resolved[corner]) return cornerWeights[corner];
+
+    const int x = static_cast<int>(cornerKeys[corner] % (side + 1));
+    const int y = static_cast<int>(cornerKeys[corner] / (side + 1));
+
+    // A corner inside the edge of a neighbouring leaf is interpolated linearly along that edge
+    const int around[4][2] = { { x - 1, y - 1 }, { x, y - 1 }, { x - 1, y }, { x, y } };
+    for (const auto& point : around)
+    {
+        if (point[0] < 0 || point[1] < 0 || point[0] >= side || point[1] >= side) continue;
+        const Cell& cell = cells[FindLeaf(point[0], point[1])];
+        int end0 = -1, end1 = -1;
+        float t = 0.0f;
+        if (x != cell.x && x != cell.x + cell.size)
+        {
+            end0 = cornerIndex[static_cast<long long>(y) * (side + 1) + cell.x];
+            end1 = cornerIndex[static_cast<long long>(y) * (side + 1) + cell.x + cell.size];
+            t = static_cast<float>(x - cell.x) / cell.size;
+        }
+        else if (y != cell.y && y != cell.y + cell.size)
+        {
+            end0 = cornerIndex[static_cast<long long>(cell.y) * (side + 1) + x];
+            end1 = cornerIndex[static_cast<long long>(cell.y + cell.size) * (side + 1) + x];
+            t = static_cast<float>(y - cell.y) / cell.size;
+        }
+        if (end0 < 0) continue;
+
+        std::vector<Weight> weights;
+        for (const Weight& w : Resolve(end0)) weights.push_back(Weight{ w.unknown, (1.0f - t) * w.weight });
+        for (const Weight& w : Resolve(end1))
+        {
+            auto same = std::find_if(weights.begin(), weights.end(), [&](const Weight& v) { return v.unknown == w.unknown; });
+            if (same != weights.end()) same->weight += t * w.weight;
+            else weights.push_back(Weight{ w.unknown, t * w.weight });
+        }
+        cornerWeights[corner] = weights;
+        resolved[corner] = 1;
+        return cornerWeights[corner];
+    }
+
+    cornerWeights[corner] = { Weight{ unknowns++, 1.0f } };
+    resolved[corner] = 1;
+    return cornerWeights[corner];
+}
+
+void QuadtreeSolver::ResolveCorners()
+{
+    cornerWeights.assign(cornerKeys.size(), std::vector<Weight>());
+    resolved.assign(cornerKeys.size(), 0);
+    for (int k = 0; k < static_cast<int>(cornerKeys.size()); k++) Resolve(k);
+}
+
+SolverStats QuadtreeSolver::Solve(const Color3* rhs, Color3* x, int width, int height, int iterations, float tolerance, float threshold)
+{
+    // Residual of the initial guess, pixels where it is significant get their own unknown
+    std::unique_ptr<Color3[]> residual = std::make_unique<Color3[]>(width * height);
+    std::vector<int> marks((width + 1) * (height + 1), 0);
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            Color3 res = rhs[i * width + j] - 4.0f * x[i * width + j];
+            if (i > 0) res += x[(i - 1) * width + j];
+            if (i + 1 < height) res += x[(i + 1) * width + j];
+            if (j > 0) res += x[i * width + j - 1];
+            if (j + 1 < width) res += x[i * width + j + 1];
+            residual[i * width + j] = res;
+            marks[(i + 1) * (width + 1) + j + 1] = std::max({ std::abs(res.x), std::abs(res.y), std::abs(res.z) }) > threshold ? 1 : 0;
+        }
+    }
+    for (int i = 1; i <= height; i++)
+    {
+        for (int j = 1; j <= width; j++)
+        {
+            marks[i * (width + 1) + j] += marks[(i - 1) * (width + 1) + j] + marks[i * (width + 1) + j - 1] - marks[(i - 1) * (width + 1) + j - 1];
+        }
+    }
+
+    QuadtreeSolver tree(width, height);
+    tree.Build(marks);
+    tree.ResolveCorners();
+    const int n = tree.unknowns;
+    const int leafCount = static_cast<int>(tree.leaves.size());
+
+    // Bilinear weights of a pixel inside a leaf
+    auto pixelWeights = [&](const Cell& cell, int i, int j, float* w)
+    {
+        const float a = static_cast<float>(j - cell.x) / cell.size;
+        const float b = static_cast<float>(i - cell.y) / cell.size;
+        w[0] = (1.0f - a) * (1.0f - b);
+        w[1] = a * (1.0f - b);
+        w[2] = (1.0f - a) * b;
+        w[3] = a * b;
+    };
+
+    // Element matrices of the links inside each leaf and of the Dirichlet boundary, element right-hand sides S^T r
+    std::vector<double> elementMatrix(16 * leafCount, 0.0);
+    std::vector<Color3> elementRhs(4 * leafCount, Color3(0.0f));
+    #pragma omp parallel for schedule(dynamic)
+    for (int l = 0; l < leafCount; l++)
+    {
+        const Cell& cell = tree.cells[tree.leaves[l]];
+        double* k = &elementMatrix[16 * l];
+        const int x1 = std::min(cell.x + cell.size, width);
+        const int y1 = std::min(cell.y + cell.size, height);
+        for (int i = cell.y; i < y1; i++)
+        {
+            for (int j = cell.x; j < x1; j++)
+            {
+                float w[4], v[4];
+                pixelWeights(cell, i, j, w);
+                const int ghosts = (i == 0) + (i == height - 1) + (j == 0) + (j == width - 1);
+                for (int a = 0; a < 4; a++)
+                {
+                    elementRhs[4 * l + a] += w[a] * residual[i * width + j];
+                    for (int b = 0; b < 4; b++) k[4 * a + b] += ghosts * w[a] * w[b];
+                }
+                if (j + 1 < x1)
+                {
+                    pixelWeights(cell, i, j + 1, v);
+                    for (int a = 0; a < 4; a++)
+                    {
+                        for (int b = 0; b < 4; b++) k[4 * a + b] += (w[a] - v[a]) * (w[b] - v[b]);
+                    }
+                }
+                if (i + 1 < y1)
+                {
+                    pixelWeights(cell, i + 1, j, v);
+                    for (int a = 0; a < 4; a++)
+                    {
+                        for (int b = 0; b < 4; b++) k[4 * a + b] += (w[a] - v[a]) * (w[b] - v[b]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Assemble S^T A S row by row
+    std::vector<std::vector<std::pair<int, double>>> rows(n);
+    std::vector<Color3> b(n, Color3(0.0f));
+    auto add = [&](int row, int column, double value)
+    {
+        for (auto& entry : rows[row])
+        {
+            if (entry.first == column)
+            {
+                entry.second += value;
+                return;
+            }
+        }
+        rows[row].push_back(std::make_pair(column, value));
+    };
+    // Outer product of a combination of corners expressed by the unknowns
+    auto addOuter = [&](const int* corners, const double* coefficients, int count)
+    {
+        std::vector<std::pair<int, double>> combination;
+        for (int c = 0; c < count; c++)
+        {
+            if (coefficients[c] == 0.0) continue;
+            for (const Weight& w : tree.cornerWeights[corners[c]])
+            {
+                auto same = std::find_if(combination.begin(), combination.end(), [&](const std::pair<int, double>& e) { return e.first == w.unknown; });
+                if (same != combination.end()) same->second += coefficients[c] * w.weight;
+                else combination.push_back(std::make_pair(w.unknown, coefficients[c] * w.weight));
+            }
+        }
+        for (const auto& r : combination)
+        {
+            for (const auto& c : combination) add(r.first, c.first, r.second * c.second);
+        }
+    };
+
+    for (int l = 0; l < leafCount; l++)
+    {
+        const int* corners = &tree.leafCorners[4 * l];
+        for (int a = 0; a < 4; a++)
+        {
+            for (const Weight& wa : tree.cornerWeights[corners[a]])
+            {
+                b[wa.unknown] += wa.weight * elementRhs[4 * l + a];
+                for (int c = 0; c < 4; c++)
+                {
+                    const double value = elementMatrix[16 * l + 4 * a + c];
+                    if (value == 0.0) continue;
+                    for (const Weight& wc : tree.cornerWeights[corners[c]]) add(wa.unknown, wc.unknown, value * wa.weight * wc.weight);
+                }
+            }
+        }
+    }
+
+    // Links between neighbouring leaves
+    std::vector<int> leafIndex(tree.cells.size(), -1);
+    for (int l = 0; l < leafCount; l++) leafIndex[tree.leaves[l]] = l;
+    for (int l = 0; l < leafCount; l++)
+    {
+        const Cell& cell = tree.cells[tree.leaves[l]];
+        const int x1 = std::min(cell.x + cell.size, width);
+        const int y1 = std::min(cell.y + cell.size, height);
+        for (int direction = 0; direction < 2; direction++)
+        {
+            // Right neighbours of the last column, bottom neighbours of the last row
+            const bool right = direction == 0;
+            if (right ? cell.x + cell.size >= width || cell.y >= height : cell.y + cell.size >= height || cell.x >= width) continue;
+            const int count = right ? y1 - cell.y : x1 - cell.x;
+            for (int t = 0; t < count; t++)
+            {
+                const int i = right ? cell.y + t : cell.y + cell.size - 1;
+                const int j = right ? cell.x + cell.size - 1 : cell.x + t;
+                const int ni = right ? i : i + 1;
+                const int nj = right ? j + 1 : j;
+                const int neighbour = leafIndex[tree.FindLeaf(nj, ni)];
+                const Cell& other = tree.cells[tree.leaves[neighbour]];
+                float w[4], v[4];
+                pixelWeights(cell, i, j, w);
+                pixelWeights(other, ni, nj, v);
+                int corners[8];
+                double coefficients[8];
+                for (int a = 0; a < 4; a++)
+                {
+                    corners[a] = tree.leafCorners[4 * l + a];
+                    corners[4 + a] = tree.leafCorners[4 * neighbour + a];
+                    coefficients[a] = w[a];
+                    coefficients[4 + a] = -v[a];
+                }
+                addOuter(corners, coefficients, 8);
+            }
+        }
+    }
+
+    // Compressed rows
+    std::vector<int> rowStart(n + 1, 0);
+    for (int r = 0; r < n; r++) rowStart[r + 1] = rowStart[r] + static_cast<int>(rows[r].size());
+    std::vector<int> columns(rowStart[n]);
+    std::vector<float> values(rowStart[n]);
+    std::vector<float> inverseDiagonal(n, 0.0f);
+    for (int r = 0; r < n; r++)
+    {
+        for (int e = 0; e < static_cast<int>(rows[r].size()); e++)
+        {
+            columns[rowStart[r] + e] = rows[r][e].first;
+            values[rowStart[r] + e] = static_cast<float>(rows[r][e].second);
+            if (rows[r][e].first == r && rows[r][e].second > 0.0) inverseDiagonal[r] = static_cast<float>(1.0 / rows[r][e].second);
+        }
+    }
+    rows.clear();
+
+    // Jacobi preconditioned conjugate gradient with per-channel step lengths
+    auto divide = [](const Color3& a, const Color3& c)
+    {
+        return Color3(c.x != 0.0f ? a.x / c.x : 0.0f, c.y != 0.0f ? a.y / c.y : 0.0f, c.z != 0.0f ? a.z / c.z : 0.0f);
+    };
+    std::vector<Color3> y(n, Color3(0.0f)), r(b), z(n), p(n), q(n);
+    double rhsSum = 0.0;
+    for (int k = 0; k < n; k++) rhsSum += SquaredLength(b[k]);
+    const double rhsNorm = rhsSum > 0.0 ? std::sqrt(rhsSum) : 1.0;
+    const float stop = tolerance > 0.0f ? tolerance : 1e-6f;
+
+    auto precondition = [&]()
+    {
+        double rzx = 0.0, rzy = 0.0, rzz = 0.0;
+        #pragma omp parallel for reduction(+:rzx, rzy, rzz)
+        for (int k = 0; k < n; k++)
+        {
+            z[k] = inverseDiagonal[k] * r[k];
+            rzx += r[k].x * z[k].x;
+            rzy += r[k].y * z[k].y;
+            rzz += r[k].z * z[k].z;
+        }
+        return Color3(static_cast<float>(rzx), static_cast<float>(rzy), static_cast<float>(rzz));
+    };
+
+    SolverStats stats;
+    stats.unknowns = n;
+    Color3 rz = precondition();
+    p = z;
+    while (stats.iterations < iterations && rhsSum > 0.0)
+    {
+        double pqx = 0.0, pqy = 0.0, pqz = 0.0;
+        #pragma omp parallel for reduction(+:pqx, pqy, pqz)
+        for (int k = 0; k < n; k++)
+        {
+            Color3 sum(0.0f);
+            for (int e = rowStart[k]; e < rowStart[k + 1]; e++) sum += values[e] * p[columns[e]];
+            q[k] = sum;
+            pqx += p[k].x * sum.x;
+            pqy += p[k].y * sum.y;
+            pqz += p[k].z * sum.z;
+        }
+        const Color3 alpha = divide(rz, Color3(static_cast<float>(pqx), static_cast<float>(pqy), static_cast<float>(pqz)));
+
+        double residualSum = 0.0;
+        #pragma omp parallel for reduction(+:residualSum)
+        for (int k = 0; k < n; k++)
+        {
+            y[k] += alpha * p[k];
+            r[k] -= alpha * q[k];
+            residualSum += SquaredLength(r[k]);
+        }
+        stats.iterations++;
+        stats.history.push_back(static_cast<float>(std::sqrt(residualSum) / rhsNorm));
+        if (stats.history.back() <= stop) break;
+
+        const Color3 rzNew = precondition();
+        const Color3 beta = divide(rzNew, rz);
+        rz = rzNew;
+        #pragma omp parallel for
+        for (int k = 0; k < n; k++)
+        {
+            p[k] = z[k] + beta * p[k];
+        }
+    }
+
+    // Interpolate the correction back to the pixels
+    #pragma omp parallel for schedule(dynamic)
+    for (int l = 0; l < leafCount; l++)
+    {
+        const Cell& cell = tree.cells[tree.leaves[l]];
+        Color3 corner[4];
+        for (int a = 0; a < 4; a++)
+        {
+            corner[a] = Color3(0.0f);
+            for (const Weight& w : tree.cornerWeights[tree.leafCorners[4 * l + a]]) corner[a] += w.weight * y[w.unknown];
+        }
+        const int x1 = std::min(cell.x + cell.size, width);
+        const int y1 = std::min(cell.y + cell.size, height);
+        for (int i = cell.y; i < y1; i++)
+        {
+            for (int j = cell.x; j < x1; j++)
+            {
+                float w[4];
+                pixelWeights(cell, i, j, w);
+                x[i * width + j] += w[0] * corner[0] + w[1] * corner[1] + w[2] * corner[2] + w[3] * corner[3];
+            }
+        }
+    }
+
+    stats.residual = PoissonSolver::RelativeResidual(rhs, x, width, height);
+    return stats;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PoissonSolver.hpp"
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Adaptive solver of the Poisson equation A u = b for a correction of a good initial guess (the cut-and-paste composite).
+/// The correction is represented by bilinear interpolation over the leaves of a quadtree which is refined to single pixels
+/// where the initial guess has a residual (along the seam) and grows coarser with the distance from them. The reduced
+/// Galerkin system S^T A S y = S^T (b - A x) has one unknown per quadtree corner and is solved by Jacobi preconditioned
+/// conjugate gradient. Corners hanging on the edge of a larger leaf are interpolated from the ends of that edge.
+/// </summary>
+class QuadtreeSolver {
+public:
+
+	/// <summary>
+	/// Solve the equation starting from the initial guess stored in x.
+	/// </summary>
+	/// <param name="rhs">right-hand side</param>
+	/// <param name="x">initial guess, overwritten by the solution</param>
+	/// <param name="width">grid width</param>
+	/// <param name="height">grid height</param>
+	/// <param name="iterations">maximum number of conjugate gradient iterations</param>
+	/// <param name="tolerance">relative residual of the reduced system at which the iterations stop (0 uses 1e-6)</param>
+	/// <param name="threshold">residual magnitude of the initial guess above which pixels get their own unknown</param>
+	/// <returns>number of iterations, final residual of the full system, reduced residual history and number of unknowns</returns>
+	static SolverStats Solve(const Color3* rhs, Color3* x, int width, int height, int iterations, float tolerance = 0.0f, float threshold = 1e-4f);
+
+private:
+
+	/// <summary>
+	/// Node of the quadtree covering pixels [x, x + size) x [y, y + size).
+	/// </summary>
+	struct Cell {
+		int x;
+		int y;
+		int size;
+		int child; // Index of the first of four children (-1 for leaves)
+	};
+
+	/// <summary>
+	/// Contribution of an unknown to the value at a corner.
+	/// </summary>
+	struct Weight {
+		int unknown;
+		float weight;
+	};
+
+	QuadtreeSolver(int width, int height);
+
+	/// <summary>
+	/// Split cells containing a marked pixel down to single pixels.
+	/// </summary>
+	/// <param name="marks">summed-area table of the marked pixels of size (width + 1) x (height + 1)</param>
+	void Build(const std::vector<int>& marks);
+
+	/// <summary>
+	/// Return leaf containing a given point of the padded square.
+	/// </summary>
+	int FindLeaf(int x, int y) const;
+
+	/// <summary>
+	/// Return index of the corner at a given position, creating it if necessary.
+	/// </summary>
+	int Corner(int x, int y);
+
+	/// <summary>
+	/// Express each corner by the unknowns, hanging corners are resolved recursively along the edge they lie on.
+	/// </summary>
+	void ResolveCorners();
+
+	/// <summary>
+	/// Resolve one corner.
+	/// </summary>
+	const std::vector<Weight>& Resolve(int corner);
+
+	int width; // Grid width
+	int height; // Grid height
+	int side; // Side of the padded square, a power of two
+	std::vector<Cell> cells; // Quadtree nodes, the root comes first
+	std::vector<int> leaves; // Indices of the leaf cells
+	std::vector<int> leafCorners; // Four corners of each leaf (top-left, top-right, bottom-left, bottom-right)
+	std::vector<long long> cornerKeys; // Position of each corner, y * (side + 1) + x
+	std::unordered_map<long long, int> cornerIndex; // Corner at each position
+	std::vector<std::vector<Weight>> cornerWeights; // Unknowns of each corner
+	std::vector<char> resolved; // Corners whose weights are final
+	int unknowns = 0; // Number of unknowns of the reduced system
+};
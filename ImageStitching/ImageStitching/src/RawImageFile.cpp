@@ -0,0 +1,97 @@
+#include "RawImageFile.hpp"
+#include <cstdint>
+
+// Size of the file header (width and height)
+const long long HEADER_SIZE{ 2 * sizeof(int32_t) };
+
+RawImageFile::~RawImageFile()
+{
+    Close();
+}
+
+bool RawImageFile::Open(const char* fileName)
+{
+    Close();
+    file = std::fopen(fileName, "rb");
+    int32_t size[2];
+    if (!file || std::fread(size, sizeof(int32_t), 2, file) != 2)
+    {
+        std::cerr << "ERROR: Could not open raw image file '" << fileName << "'.\n";
+        Close();
+        return false;
+    }
+    width = size[0];
+    height = size[1];
+    return true;
+}
+
+bool RawImageFile::Create(const char* fileName, int width, int height)
+{
+    Close();
+    file = std::fopen(fileName, "w+b");
+    const int32_t size[2] = { width, height };
+    if (!file || std::fwrite(size, sizeof(int32_t), 2, file) != 2)
+    {
+        std::cerr << "ERROR: Could not create raw image file '" << fileName << "'.\n";
+        Close();
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    return true;
+}
+
+void RawImageFile::Close()
+{
+    if (file) std::fclose(file);
+    file = nullptr;
+    width = height = 0;
+}
+
+int RawImageFile::Width()
+{
+    return width;
+}
+
+int RawImageFile::Height()
+{
+    return height;
+}
+
+bool RawImageFile::Seek(int x, int y)
+{
+    const long long offset = HEADER_SIZE + (static_cast<long long>(y) * width + x) * static_cast<long long>(sizeof(Color3));
+#ifdef _MSC_VER
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool RawImageFile::Read(int x, int y, int blockWidth, int blockHeight, Color3* block)
+{
+    if (!file || x < 0 || y < 0 || x + blockWidth > width || y + blockHeight > height) return false;
+    for (int i = 0; i < blockHeight; i++)
+    {
+        if (!Seek(x, y + i)) return false;
+        if (std::fread(block + static_cast<long long>(i) * blockWidth, sizeof(Color3), blockWidth, file) != static_cast<size_t>(blockWidth)) return false;
+    }
+    return true;
+}
+
+bool RawImageFile::Write(int x, int y, int blockWidth, int blockHeight, const Color3* block)
+{
+    if (!file || x < 0 || y < 0 || x + blockWidth > width || y + blockHeight > height) return false;
+    for (int i = 0; i < blockHeight; i++)
+    {
+        if (!Seek(x, y + i)) return false;
+        if (std::fwrite(block + static_cast<long long>(i) * blockWidth, sizeof(Color3), blockWidth, file) != static_cast<size_t>(blockWidth)) return false;
+    }
+    return true;
+}
+
+bool RawImageFile::Save(const char* fileName, const Color3* data, int width, int height)
+{
+    RawImageFile raw;
+    return raw.Create(fileName, width, height) && raw.Write(0, 0, width, height, data);
+}
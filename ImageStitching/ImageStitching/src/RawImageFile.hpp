@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <cstdio>
+
+/// <summary>
+/// Uncompressed image file for streaming access to images that do not fit into memory. The file holds the width and height
+/// as two 32-bit integers followed by the Color3 pixels in row-major order, rectangular blocks are read and written in place.
+/// </summary>
+class RawImageFile {
+public:
+
+	RawImageFile() = default;
+
+	~RawImageFile();
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	RawImageFile(const RawImageFile&) = delete;
+	void operator=(const RawImageFile&) = delete;
+	RawImageFile(RawImageFile&&) = delete;
+	RawImageFile& operator=(RawImageFile&&) = delete;
+
+	/// <summary>
+	/// Open existing file for reading.
+	/// </summary>
+	/// <param name="fileName">file path</param>
+	/// <returns>true on success</returns>
+	bool Open(const char* fileName);
+
+	/// <summary>
+	/// Create file of a given size for writing, the pixels are written block by block.
+	/// </summary>
+	/// <param name="fileName">file path</param>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <returns>true on success</returns>
+	bool Create(const char* fileName, int width, int height);
+
+	/// <summary>
+	/// Close the file.
+	/// </summary>
+	void Close();
+
+	/// <summary>
+	/// Return width of the image.
+	/// </summary>
+	/// <returns>width</returns>
+	int Width();
+
+	/// <summary>
+	/// Return height of the image.
+	/// </summary>
+	/// <returns>height</returns>
+	int Height();
+
+	/// <summary>
+	/// Read rectangular block of pixels.
+	/// </summary>
+	/// <param name="x">first column</param>
+	/// <param name="y">first row</param>
+	/// <param name="blockWidth">block width</param>
+	/// <param name="blockHeight">block height</param>
+	/// <param name="block">output pixels of size blockWidth x blockHeight</param>
+	/// <returns>true on success</returns>
+	bool Read(int x, int y, int blockWidth, int blockHeight, Color3* block);
+
+	/// <summary>
+	/// Write rectangular block of pixels.
+	/// </summary>
+	/// <param name="x">first column</param>
+	/// <param name="y">first row</param>
+	/// <param name="blockWidth">block width</param>
+	/// <param name="blockHeight">block height</param>
+	/// <param name="block">pixels of size blockWidth x blockHeight</param>
+	/// <returns>true on success</returns>
+	bool Write(int x, int y, int blockWidth, int blockHeight, const Color3* block);
+
+	/// <summary>
+	/// Save whole image in memory as a raw file.
+	/// </summary>
+	/// <param name="fileName">file path</param>
+	/// <param name="data">pixels</param>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <returns>true on success</returns>
+	static bool Save(const char* fileName, const Color3* data, int width, int height);
+
+private:
+
+	/// <summary>
+	/// Move to the first pixel of a block row.
+	/// </summary>
+	bool Seek(int x, int y);
+
+	FILE* file = nullptr; // Open file
+	int width = 0; // Image width
+	int height = 0; // Image height
+};
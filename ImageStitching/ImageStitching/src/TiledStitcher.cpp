@@ -0,0 +1,255 @@
+#include "TiledStitcher.hpp"
+#include "RawImageFile.hpp"
+#include <algorithm>
+
+// Full-size Color3 arrays of one Poisson problem: two images, right-hand side, solution and about six arrays of the solver
+const size_t PROBLEM_ARRAYS{ 10 };
+
+size_t TiledStitcher::EstimateMemory(int width, int height, int factor, int tileSize, int overlap)
+{
+    const size_t pixel = sizeof(Color3);
+    const size_t coarseWidth = (width + factor - 1) / factor;
+    const size_t coarseHeight = (height + factor - 1) / factor;
+    const size_t coarse = coarseWidth * coarseHeight * pixel;
+
+    // Global solve with one band of input rows
+    const size_t global = PROBLEM_ARRAYS * coarse + static_cast<size_t>(factor) * width * pixel;
+    if (tileSize <= 0) return global;
+
+    // Tile refinement next to the kept coarse solution
+    const size_t side = static_cast<size_t>(tileSize) + 2 * overlap + 2;
+    return std::max(global, coarse + PROBLEM_ARRAYS * side * side * pixel);
+}
+
+bool TiledStitcher::Stitch(const char* firstFile, const char* secondFile, const char* outputFile, const TiledSettings& settings, TiledStats* stats)
+{
+    RawImageFile first;
+    RawImageFile second;
+    if (!first.Open(firstFile) || !second.Open(secondFile)) return false;
+    const int width = first.Width();
+    const int height = first.Height();
+    if (second.Width() != width || second.Height() != height || width < 2 || height < 1)
+    {
+        std::cerr << "ERROR: Stitched images must have the same size.\n";
+        return false;
+    }
+
+    // Smallest downsampling factor whose global problem fits into half of the budget, the rest is left for the tiles
+    int factor = 1;
+    while (EstimateMemory(width, height, factor, 0, 0) > settings.memoryBudget / 2)
+    {
+        factor *= 2;
+        if (factor > std::max(width, height))
+        {
+            std::cerr << "ERROR: Memory budget is too small for the global solve.\n";
+            return false;
+        }
+    }
+    int tileSize = settings.tileSize;
+    if (tileSize <= 0)
+    {
+        tileSize = 16;
+        while (tileSize < std::max(width, height) && EstimateMemory(width, height, factor, 2 * tileSize, settings.overlap) <= settings.memoryBudget)
+        {
+            tileSize *= 2;
+        }
+    }
+    const size_t memory = EstimateMemory(width, height, factor, tileSize, settings.overlap);
+    if (memory > settings.memoryBudget)
+    {
+        std::cerr << "ERROR: Stitching needs " << memory << " bytes, the memory budget is " << settings.memoryBudget << " bytes.\n";
+        return false;
+    }
+
+    const int seam = width / 2;
+    const int coarseWidth = (width + factor - 1) / factor;
+    const int coarseHeight = (height + factor - 1) / factor;
+    const int coarseSeam = std::clamp((seam + factor / 2) / factor, 1, std::max(coarseWidth - 1, 1));
+
+    // Box-downsampled images, streamed by bands of factor rows
+    std::unique_ptr<Color3[]> correction = std::make_unique<Color3[]>(coarseWidth * coarseHeight);
+    {
+        std::unique_ptr<Color3[]> coarseFirst = std::make_unique<Color3[]>(coarseWidth * coarseHeight);
+        std::unique_ptr<Color3[]> coarseSecond = std::make_unique<Color3[]>(coarseWidth * coarseHeight);
+        std::unique_ptr<Color3[]> band = std::make_unique<Color3[]>(static_cast<size_t>(factor) * width);
+
+        for (int r = 0; r < coarseHeight; r++)
+        {
+            const int rows = std::min(factor, height - r * factor);
+            RawImageFile* files[2] = { &first, &second };
+            Color3* targets[2] = { coarseFirst.get(), coarseSecond.get() };
+            for (int k = 0; k < 2; k++)
+            {
+                if (!files[k]->Read(0, r * factor, width, rows, band.get()))
+                {
+                    std::cerr << "ERROR: Could not read input rows.\n";
+                    return false;
+                }
+                #pragma omp parallel for
+                for (int j = 0; j < coarseWidth; j++)
+                {
+                    const int x1 = std::min(width, (j + 1) * factor);
+                    Color3 sum(0.0f);
+                    for (int i = 0; i < rows; i++)
+                    {
+                        for (int x = j * factor; x < x1; x++) sum += band[i * width + x];
+                    }
+                    targets[k][r * coarseWidth + j] = sum / static_cast<float>(rows * (x1 - j * factor));
+                }
+            }
+        }
+
+        // Cutting from the first to the second image at the seam replaces the jump of the composite by the mean gradient,
+        // the difference is the mean of (second - first) at both pixels next to the seam
+        std::unique_ptr<Color3[]> rhs = std::make_unique<Color3[]>(coarseWidth * coarseHeight);
+        std::fill(rhs.get(), rhs.get() + coarseWidth * coarseHeight, Color3(0.0f));
+        std::fill(correction.get(), correction.get() + coarseWidth * coarseHeight, Color3(0.0f));
+        for (int i = 0; i < coarseHeight; i++)
+        {
+            const int p = i * coarseWidth + coarseSeam - 1;
+            const Color3 jump = 0.5f * (coarseSecond[p] - coarseFirst[p] + coarseSecond[p + 1] - coarseFirst[p + 1]);
+            rhs[p] += jump;
+            rhs[p + 1] -= jump;
+        }
+        PoissonSolver::Solve(rhs.get(), correction.get(), coarseWidth, coarseHeight, settings.coarse);
+    }
+
+    // Bilinear interpolation of the coarse correction at a full-resolution pixel
+    auto upsample = [&](int x, int y)
+    {
+        const float u = std::clamp((x + 0.5f) / factor - 0.5f, 0.0f, static_cast<float>(coarseWidth - 1));
+        const float v = std::clamp((y + 0.5f) / factor - 0.5f, 0.0f, static_cast<float>(coarseHeight - 1));
+        const int j = std::min(static_cast<int>(u), std::max(coarseWidth - 2, 0));
+        const int i = std::min(static_cast<int>(v), std::max(coarseHeight - 2, 0));
+        const int j1 = std::min(j + 1, coarseWidth - 1);
+        const int i1 = std::min(i + 1, coarseHeight - 1);
+        const float fx = u - j;
+        const float fy = v - i;
+        return (1.0f - fy) * ((1.0f - fx) * correction[i * coarseWidth + j] + fx * correction[i * coarseWidth + j1]) +
+            fy * ((1.0f - fx) * correction[i1 * coarseWidth + j] + fx * correction[i1 * coarseWidth + j1]);
+    };
+
+    RawImageFile output;
+    if (!output.Create(outputFile, width, height)) return false;
+
+    const int overlap = settings.overlap;
+    const int refinedBand = std::max(overlap, 2 * factor);
+    const int regionSide = tileSize + 2 * overlap + 2;
+    std::unique_ptr<Color3[]> regionFirst = std::make_unique<Color3[]>(regionSide * regionSide);
+    std::unique_ptr<Color3[]> regionSecond = std::make_unique<Color3[]>(regionSide * regionSide);
+    std::unique_ptr<Color3[]> regionRhs = std::make_unique<Color3[]>(regionSide * regionSide);
+    std::unique_ptr<Color3[]> regionCorrection = std::make_unique<Color3[]>(regionSide * regionSide);
+    std::unique_ptr<Color3[]> tile = std::make_unique<Color3[]>(tileSize * tileSize);
+    int tiles = 0;
+    int refinedTiles = 0;
+
+    for (int y0 = 0; y0 < height; y0 += tileSize)
+    {
+        for (int x0 = 0; x0 < width; x0 += tileSize)
+        {
+            const int w = std::min(tileSize, width - x0);
+            const int h = std::min(tileSize, height - y0);
+            const bool refined = factor > 1 && x0 < seam + refinedBand && x0 + w > seam - refinedBand;
+            bool ok = true;
+
+            if (!refined)
+            {
+                // The coarse correction is smooth away from the seam (or exact without downsampling)
+                ok = (x0 < seam ? first : second).Read(x0, y0, w, h, tile.get());
+                if (x0 < seam && x0 + w > seam)
+                {
+                    ok = ok && second.Read(x0, y0, w, h, regionSecond.get());
+                }
+                #pragma omp parallel for
+                for (int i = 0; i < h; i++)
+                {
+                    for (int j = 0; j < w; j++)
+                    {
+                        if (x0 < seam && x0 + j >= seam) tile[i * w + j] = regionSecond[i * w + j];
+                        tile[i * w + j] += upsample(x0 + j, y0 + i);
+                    }
+                }
+            }
+            else
+            {
+                // Region of the tile with the overlap, never cut between the two pixels next to the seam
+                int rx0 = std::max(0, x0 - overlap);
+                int rx1 = std::min(width, x0 + w + overlap);
+                const int ry0 = std::max(0, y0 - overlap);
+                const int ry1 = std::min(height, y0 + h + overlap);
+                if (rx0 == seam) rx0--;
+                if (rx1 == seam) rx1++;
+                const int rw = rx1 - rx0;
+                const int rh = ry1 - ry0;
+                ok = first.Read(rx0, ry0, rw, rh, regionFirst.get()) && second.Read(rx0, ry0, rw, rh, regionSecond.get());
+
+                // Seam jumps and the coarse correction outside the region as Dirichlet values
+                #pragma omp parallel for
+                for (int i = 0; i < rh; i++)
+                {
+                    const int y = ry0 + i;
+                    for (int j = 0; j < rw; j++)
+                    {
+                        const int x = rx0 + j;
+                        const int p = i * rw + j;
+                        Color3 b(0.0f);
+                        if (x == seam - 1 || x == seam)
+                        {
+                            const int q = x == seam - 1 ? p + 1 : p - 1;
+                            const Color3 jump = 0.5f * (regionSecond[p] - regionFirst[p] + regionSecond[q] - regionFirst[q]);
+                            b += x == seam - 1 ? jump : -jump;
+                        }
+                        if (j == 0 && x > 0) b += upsample(x - 1, y);
+                        if (j == rw - 1 && x < width - 1) b += upsample(x + 1, y);
+                        if (i == 0 && y > 0) b += upsample(x, y - 1);
+                        if (i == rh - 1 && y < height - 1) b += upsample(x, y + 1);
+                        regionRhs[p] = b;
+                        regionCorrection[p] = upsample(x, y);
+                    }
+                }
+                PoissonSolver::Solve(regionRhs.get(), regionCorrection.get(), rw, rh, settings.tile);
+
+                #pragma omp parallel for
+                for (int i = 0; i < h; i++)
+                {
+                    for (int j = 0; j < w; j++)
+                    {
+                        const int p = (y0 + i - ry0) * rw + x0 + j - rx0;
+                        tile[i * w + j] = (x0 + j < seam ? regionFirst[p] : regionSecond[p]) + regionCorrection[p];
+                    }
+                }
+                refinedTiles++;
+            }
+
+            #pragma omp parallel for
+            for (int i = 0; i < h; i++)
+            {
+                for (int j = 0; j < w; j++)
+                {
+                    tile[i * w + j].x = std::clamp(tile[i * w + j].x, 0.0f, 1.0f);
+                    tile[i * w + j].y = std::clamp(tile[i * w + j].y, 0.0f, 1.0f);
+                    tile[i * w + j].z = std::clamp(tile[i * w + j].z, 0.0f, 1.0f);
+                }
+            }
+
+            if (!ok || !output.Write(x0, y0, w, h, tile.get()))
+            {
+                std::cerr << "ERROR: Could not stream tile at " << x0 << ", " << y0 << ".\n";
+                return false;
+            }
+            tiles++;
+        }
+    }
+
+    if (stats)
+    {
+        stats->factor = factor;
+        stats->coarseWidth = coarseWidth;
+        stats->coarseHeight = coarseHeight;
+        stats->tileSize = tileSize;
+        stats->tiles = tiles;
+        stats->refinedTiles = refinedTiles;
+        stats->memory = memory;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "PoissonSolver.hpp"
+#include <cstddef>
+
+/// <summary>
+/// Settings of the out-of-core stitching.
+/// </summary>
+struct TiledSettings {
+	size_t memoryBudget = size_t(512) << 20; // Upper bound of the working memory in bytes
+	int tileSize = 0; // Side of the output tiles (0 picks the largest tile fitting into the budget)
+	int overlap = 32; // Margin solved around each refined tile and half-width of the refined band around the seam
+	PoissonSettings coarse = PoissonSettings(PoissonMethod::Multigrid); // Solver of the downsampled problem
+	PoissonSettings tile = PoissonSettings(PoissonMethod::Multigrid); // Solver of the tile refinements
+};
+
+/// <summary>
+/// Statistics of a finished out-of-core stitching.
+/// </summary>
+struct TiledStats {
+	int factor = 0; // Downsampling factor of the global solve
+	int coarseWidth = 0; // Width of the global problem
+	int coarseHeight = 0; // Height of the global problem
+	int tileSize = 0; // Side of the output tiles
+	int tiles = 0; // Number of written tiles
+	int refinedTiles = 0; // Number of tiles solved at full resolution
+	size_t memory = 0; // Estimated peak working memory in bytes
+};
+
+/// <summary>
+/// Gradient-domain stitching of two images stored in raw files (see RawImageFile) that do not fit into memory.
+/// The left half of the output comes from the first image and the right half from the second one, the seam is hidden by a
+/// correction field whose right-hand side is non-zero only at the seam and which vanishes at the image border.
+/// The field is solved globally on a box-downsampled grid, tiles near the seam are re-solved at full resolution with the
+/// upsampled coarse field as boundary values, all other tiles use the upsampled coarse field directly.
+/// Inputs are streamed by bands of rows and the output is written tile by tile.
+/// </summary>
+class TiledStitcher {
+public:
+
+	/// <summary>
+	/// Stitch two raw images of the same size into a raw output file.
+	/// </summary>
+	/// <param name="firstFile">raw file of the first (left) image</param>
+	/// <param name="secondFile">raw file of the second (right) image</param>
+	/// <param name="outputFile">raw output file</param>
+	/// <param name="settings">stitching settings</param>
+	/// <param name="stats">optional output of stitching statistics</param>
+	/// <returns>false if the files cannot be used or the problem does not fit into the memory budget</returns>
+	static bool Stitch(const char* firstFile, const char* secondFile, const char* outputFile, const TiledSettings& settings = TiledSettings(), TiledStats* stats = nullptr);
+
+	/// <summary>
+	/// Estimate peak working memory of a stitching configuration.
+	/// </summary>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <param name="factor">downsampling factor of the global solve</param>
+	/// <param name="tileSize">side of the output tiles</param>
+	/// <param name="overlap">margin of the refined tiles</param>
+	/// <returns>memory in bytes</returns>
+	static size_t EstimateMemory(int width, int height, int factor, int tileSize, int overlap);
+};
@@ -1,6 +1,10 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Image.hpp"
+#include "Alignment.hpp"
+#include "Panorama.hpp"
+#include "RawImageFile.hpp"
+#include "TiledStitcher.hpp"
 
 // std
 #include <algorithm>
@@ -12,6 +16,9 @@ Image img("../Resources/s1.png", grayScale);
 Image img1("../Resources/s2.png", grayScale);
 
 std::unique_ptr<Color3[]> pixelBuffer;
+MultiBandBlender blender;
+MeanValueCloner cloner;
+int cloneOffset = -1;
 
 void updatePixelBuffer() {
     // Update transformed image
@@ -55,6 +62,114 @@ void updatePixelBuffer() {
 
 }
 
+void stitch(const PoissonSettings& settings) {
+    SolverStats stats = img.ImageStitching(img1, settings);
+    std::cout << "Iterations: " << stats.iterations << ", relative residual: " << stats.residual << std::endl;
+    if (stats.unknowns > 0) std::cout << "Unknowns: " << stats.unknowns << std::endl;
+    for (int i = 0; i < static_cast<int>(stats.history.size()); i++)
+    {
+        std::cout << "  " << i + 1 << ": " << stats.history[i] << std::endl;
+    }
+    updatePixelBuffer();
+}
+
+void panorama() {
+    Homography homography;
+    AlignmentStats stats;
+    bool aligned = Alignment::Align(img, img1, homography, AlignmentSettings(), &stats);
+    std::cout << "Features: " << stats.features1 << " / " << stats.features2 << ", matches: " << stats.matches << ", inliers: " << stats.inliers << std::endl;
+    std::cout << "Detection: " << stats.detectionTime << " ms, matching: " << stats.matchingTime << " ms, RANSAC: " << stats.ransacTime << " ms" << std::endl;
+    if (!aligned)
+    {
+        std::cout << "Alignment failed" << std::endl;
+        return;
+    }
+
+    WarpedImage warped = Alignment::Warp(img1, homography);
+    Panorama pano;
+    pano.Add(img, 0, 0);
+    pano.Add(PanoramaImage{ warped.pixels.get(), warped.mask.get(), warped.width, warped.height, warped.offsetX, warped.offsetY });
+    Color3* output = pano.Compose();
+    Image result(output, pano.Width(), pano.Height());
+    result.SavePNG("../Resources/panorama.png");
+    delete[] output;
+    std::cout << "Panorama saved as 'panorama.png'\n";
+}
+
+void seamlessClone() {
+    // Elliptic region in the middle of the second image, the weights are computed once and every press moves the paste
+    if (cloneOffset < 0)
+    {
+        std::unique_ptr<float[]> mask = std::make_unique<float[]>(img1.Width() * img1.Height());
+        for (int i = 0; i < img1.Height(); i++)
+        {
+            for (int j = 0; j < img1.Width(); j++)
+            {
+                const float u = (j - 0.5f * img1.Width()) / (0.25f * img1.Width());
+                const float v = (i - 0.5f * img1.Height()) / (0.25f * img1.Height());
+                mask[i * img1.Width() + j] = u * u + v * v <= 1.0f ? 1.0f : 0.0f;
+            }
+        }
+        if (!cloner.Prepare(mask.get(), img1.Width(), img1.Height())) return;
+        cloneOffset = -img.Width() / 4;
+        std::cout << "Nodes: " << cloner.Nodes() << ", boundary vertices per node: " << cloner.Samples() << std::endl;
+    }
+    double time = img.SeamlessClone(img1, cloner, cloneOffset, 0);
+    std::cout << "Cloned at offset " << cloneOffset << " in " << time << " ms" << std::endl;
+    cloneOffset = cloneOffset + 16 > img.Width() / 4 ? -img.Width() / 4 : cloneOffset + 16;
+    updatePixelBuffer();
+}
+
+void poissonClone() {
+    // Two thick brush strokes across the second image
+    const int width = img1.Width();
+    const int height = img1.Height();
+    const float radius = 0.06f * std::min(width, height);
+    const float strokes[2][4] = { { 0.2f, 0.3f, 0.8f, 0.5f }, { 0.5f, 0.2f, 0.4f, 0.8f } };
+    std::unique_ptr<float[]> mask = std::make_unique<float[]>(width * height);
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            mask[i * width + j] = 0.0f;
+            for (const auto& stroke : strokes)
+            {
+                const float x0 = stroke[0] * width, y0 = stroke[1] * height;
+                const float dx = stroke[2] * width - x0, dy = stroke[3] * height - y0;
+                const float t = std::clamp(((j - x0) * dx + (i - y0) * dy) / (dx * dx + dy * dy), 0.0f, 1.0f);
+                const float ex = j - x0 - t * dx, ey = i - y0 - t * dy;
+                if (ex * ex + ey * ey <= radius * radius) mask[i * width + j] = 1.0f;
+            }
+        }
+    }
+
+    PoissonSettings settings(PoissonMethod::ConjugateGradient);
+    settings.tolerance = 1e-5f;
+    SolverStats stats = img.PoissonClone(img1, mask.get(), 0, 0, settings);
+    std::cout << "Unknowns: " << stats.unknowns << ", iterations: " << stats.iterations << ", relative residual: " << stats.residual << std::endl;
+    updatePixelBuffer();
+}
+
+void tiledStitch() {
+    // Inputs are converted to raw files, the stitcher streams them with a small budget to exercise the tiling
+    RawImageFile::Save("../Resources/stitch1.raw", img.DataPtr(), img.Width(), img.Height());
+    RawImageFile::Save("../Resources/stitch2.raw", img1.DataPtr(), img1.Width(), img1.Height());
+
+    TiledSettings settings;
+    settings.memoryBudget = size_t(4) << 20;
+    TiledStats stats;
+    if (!TiledStitcher::Stitch("../Resources/stitch1.raw", "../Resources/stitch2.raw", "../Resources/tiled.raw", settings, &stats)) return;
+    std::cout << "Downsampling: " << stats.factor << " (" << stats.coarseWidth << "x" << stats.coarseHeight << "), tile size: " << stats.tileSize
+        << ", tiles: " << stats.tiles << " (" << stats.refinedTiles << " refined), memory: " << (stats.memory >> 10) << " KB" << std::endl;
+
+    RawImageFile raw;
+    if (!raw.Open("../Resources/tiled.raw")) return;
+    std::unique_ptr<Color3[]> pixels = std::make_unique<Color3[]>(raw.Width() * raw.Height());
+    raw.Read(0, 0, raw.Width(), raw.Height(), pixels.get());
+    Image result(pixels.get(), raw.Width(), raw.Height());
+    result.SavePNG("../Resources/tiled.png");
+    std::cout << "Tiled stitching saved as 'tiled.png'\n";
+}
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
@@ -89,10 +204,74 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
     if (key == GLFW_KEY_I && action == GLFW_PRESS)
     {
-
-        img.ImageStitching(img1);
+        stitch(PoissonMethod::Jacobi);
+    }
+    if (key == GLFW_KEY_W && action == GLFW_PRESS)
+    {
+        PoissonSettings settings(PoissonMethod::Jacobi);
+        settings.warmStart = true;
+        settings.tolerance = 1e-4f;
+        stitch(settings);
+    }
+    if (key == GLFW_KEY_O && action == GLFW_PRESS)
+    {
+        PoissonSettings settings(PoissonMethod::SOR);
+        settings.warmStart = true;
+        settings.tolerance = 1e-4f;
+        stitch(settings);
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        PoissonSettings settings(PoissonMethod::ConjugateGradient);
+        settings.tolerance = 1e-5f;
+        stitch(settings);
+    }
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        PoissonSettings settings(PoissonMethod::Multigrid);
+        settings.band = 32;
+        stitch(settings);
+    }
+    if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    {
+        stitch(PoissonMethod::Multigrid);
+    }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        stitch(PoissonMethod::FullMultigrid);
+    }
+    if (key == GLFW_KEY_D && action == GLFW_PRESS)
+    {
+        stitch(PoissonMethod::Direct);
+    }
+    if (key == GLFW_KEY_K && action == GLFW_PRESS)
+    {
+        PoissonSettings settings(PoissonMethod::Quadtree);
+        settings.tolerance = 1e-5f;
+        stitch(settings);
+    }
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        img.MultiBandStitching(img1, blender);
+        std::cout << "Multi-band blending with " << blender.Levels() << " levels" << std::endl;
         updatePixelBuffer();
     }
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        seamlessClone();
+    }
+    if (key == GLFW_KEY_X && action == GLFW_PRESS)
+    {
+        poissonClone();
+    }
+    if (key == GLFW_KEY_U && action == GLFW_PRESS)
+    {
+        tiledStitch();
+    }
+    if (key == GLFW_KEY_A && action == GLFW_PRESS)
+    {
+        panorama();
+    }
 
 }
 
@@ -106,7 +285,20 @@ int main() {
     std::cout << "[Q] Quantization" << std::endl;
     std::cout << "[C] Non-linear contrast" << std::endl;
     std::cout << "[S] Save transformed image" << std::endl;
-    std::cout << "[I] Image stitching" << std::endl;
+    std::cout << "[I] Image stitching (Jacobi)" << std::endl;
+    std::cout << "[W] Image stitching (Jacobi from the composite until convergence)" << std::endl;
+    std::cout << "[O] Image stitching (red-black SOR until convergence)" << std::endl;
+    std::cout << "[P] Image stitching (multigrid preconditioned conjugate gradient)" << std::endl;
+    std::cout << "[M] Image stitching (multigrid V-cycles)" << std::endl;
+    std::cout << "[F] Image stitching (full multigrid)" << std::endl;
+    std::cout << "[D] Image stitching (direct DST solve)" << std::endl;
+    std::cout << "[B] Image stitching (multigrid in a band around the seam)" << std::endl;
+    std::cout << "[K] Image stitching (quadtree-adaptive correction)" << std::endl;
+    std::cout << "[L] Image stitching (multi-band Laplacian pyramid blending)" << std::endl;
+    std::cout << "[U] Image stitching (out-of-core tiles)" << std::endl;
+    std::cout << "[V] Seamless cloning by mean-value coordinates (repeat to move the region)" << std::endl;
+    std::cout << "[X] Poisson cloning of brush strokes (masked conjugate gradient)" << std::endl;
+    std::cout << "[A] Align both images and compose a panorama" << std::endl;
     
     pixelBuffer = std::make_unique<Color3[]>((2 * img.Width()) * (1.5 * img.Height()));
 
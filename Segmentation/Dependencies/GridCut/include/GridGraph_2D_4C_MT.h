@@ -8,35 +8,9 @@
 #include <vector>
 #include <new>
 
-#ifdef __GNUC__
-  #include <stdint.h>
-#endif
-
-#ifdef _WIN32
-  extern "C" struct _SECURITY_ATTRIBUTES;
-  extern "C" __declspec(dllimport) void* __stdcall
-  CreateThread(_SECURITY_ATTRIBUTES*,
-               #if defined(_WIN64)
-                 unsigned __int64,
-               #else
-                 unsigned long,
-               #endif
-               unsigned long (__stdcall *)(void*),void*,unsigned long,unsigned long*);
-  extern "C" __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void*,unsigned long);    
-  #ifdef _WIN64
-    #include <intrin.h>
-    #define InterlockedCompareExchange _InterlockedCompareExchange
-    #define InterlockedIncrement _InterlockedIncrement
-  #else
-    extern "C" __declspec(dllimport) long __stdcall InterlockedCompareExchange(long volatile*,long,long);
-    extern "C" __declspec(dllimport) long __stdcall InterlockedIncrement(long volatile*);
-  #endif
-#else
-  #include <pthread.h>
-  #ifdef __APPLE__
-    #include <libkern/OSAtomic.h>
-  #endif
-#endif
+#include <stdint.h>
+#include <atomic>
+#include <thread>
 
 template
 <
@@ -253,136 +227,28 @@ private:
     }
   };
 
-#ifdef _WIN32  
-  typedef void* ThreadHandle;
+  // Threads and the spinlock use the standard library, so the same code builds on Windows and Linux
+  typedef std::thread* ThreadHandle;
 
-  ThreadHandle threadCreate(unsigned long (__stdcall *start_routine)(void*),void* arg)
-  {
-    return CreateThread(NULL,0,start_routine,arg,0,NULL);
-  }
+  typedef std::atomic_flag Spinlock;
 
-  void threadJoin(ThreadHandle handle)
+  void spin_init(Spinlock* spinlock)
   {
-    WaitForSingleObject(handle,0xFFFFFFFF);
+    spinlock->clear();
   }
 
-  #define THREAD_FUNC_WRAPPER_DECL static unsigned long __stdcall thread_func_wrapper(void* arg)
-
-  typedef long Spinlock;
-
-  void spin_init(volatile Spinlock* spinlock)
+  void spin_lock(Spinlock* spinlock)
   {
-    *spinlock = 1;
-  }
-
-  void spin_lock(volatile Spinlock* spinlock)
-  {
-    while (InterlockedCompareExchange(spinlock,2,1)==2)
+    while (spinlock->test_and_set(std::memory_order_acquire))
     {
     }
   }
 
-  void spin_unlock(volatile Spinlock* spinlock)
+  void spin_unlock(Spinlock* spinlock)
   {
-    InterlockedCompareExchange(spinlock,1,2);
+    spinlock->clear(std::memory_order_release);
   }
 
-  void spin_destroy(volatile Spinlock* spinlock)
-  {
-
-  }
-#else
-  typedef pthread_t ThreadHandle;
-
-  ThreadHandle threadCreate(void*(*start_routine)(void*),void* arg)
-  {
-    pthread_t thread_handle;
-    pthread_attr_t thread_attr;
-
-    pthread_attr_init(&thread_attr);
-    pthread_attr_setdetachstate(&thread_attr,PTHREAD_CREATE_JOINABLE);
-
-    pthread_create(&thread_handle,&thread_attr,start_routine,arg);
-
-    return thread_handle;
-  }
-
-  void threadJoin(ThreadHandle handle)
-  {
-    pthread_join(handle,NULL);
-  }
-
-  #define THREAD_FUNC_WRAPPER_DECL static void* thread_func_wrapper(void* arg)
-
-  #ifdef __APPLE__
-    typedef OSSpinLock Spinlock;
-
-    void spin_init(volatile Spinlock* spinlock)
-    {
-      *spinlock = OS_SPINLOCK_INIT;
-    }
-
-    void spin_lock(volatile Spinlock* spinlock)
-    {
-      OSSpinLockLock(spinlock);
-    }
-
-    void spin_unlock(volatile Spinlock* spinlock)
-    {
-      OSSpinLockUnlock(spinlock);
-    }
-
-    void spin_destroy(volatile Spinlock* spinlock)
-    {
-    }    
-  #elif __ANDROID__
-    typedef long Spinlock;
-
-    void spin_init(volatile Spinlock* spinlock)
-    {
-      *spinlock = 1;
-    }
-
-    void spin_lock(volatile Spinlock* spinlock)
-    {
-      while (__sync_val_compare_and_swap(spinlock,1,2)==2)
-      {
-      }
-    }
-
-    void spin_unlock(volatile Spinlock* spinlock)
-    {
-      __sync_val_compare_and_swap(spinlock,2,1);
-    }
-
-    void spin_destroy(volatile Spinlock* spinlock)
-    {
-    }
-  #else
-    typedef pthread_spinlock_t Spinlock;
-
-    void spin_init(volatile Spinlock* spinlock)
-    {
-      pthread_spin_init(spinlock,PTHREAD_PROCESS_PRIVATE);
-    }
-
-    void spin_lock(volatile Spinlock* spinlock)
-    {
-      pthread_spin_lock(spinlock);
-    }
-
-    void spin_unlock(volatile Spinlock* spinlock)
-    {
-      pthread_spin_unlock(spinlock);
-    }
-
-    void spin_destroy(volatile Spinlock* spinlock)
-    {
-      pthread_spin_destroy(spinlock);
-    }
-  #endif
-#endif
-
   struct Thread
   {
     ThreadHandle handle;
@@ -409,7 +275,7 @@ private:
 
   bool* block_locked;
   int* block_TIME;
-  int next_block_id;
+  std::atomic<int> next_block_id;
 
   int NUM_THREADS;
 
@@ -484,12 +350,6 @@ private:
     return ((x-1)/8)*8+8;
   }
 
-#ifdef _WIN32
-  #define ATOMIC_INCREMENT(X) (InterlockedIncrement((long*)(X))-1)
-#else
-  #define ATOMIC_INCREMENT(X) (__sync_fetch_and_add(X,1))
-#endif
-
   void* align(void* mem,size_t boundary)
   {
     uintptr_t mask = ~(uintptr_t)(boundary - 1);
@@ -516,21 +376,6 @@ private:
   {
     return a > b ? a : b;
   }
-
-  struct thread_func_wrapper_arg
-  {
-    void* thisptr;
-    void* arg;
-  };
-
-  THREAD_FUNC_WRAPPER_DECL
-  {
-    thread_func_wrapper_arg* wrapper_arg = (thread_func_wrapper_arg*)arg;
-
-    ((GridGraph_2D_4C_MT<type_tcap,type_ncap,type_flow>*)wrapper_arg->thisptr)->thread_func(wrapper_arg->arg);
-
-    return 0;
-  }
 };
 
 #define SISTER(E) (SISTER_TABLE[(E)])
@@ -982,7 +827,7 @@ thread_func(void* arg)
 
   while(1)
   {
-    const int block_id = ATOMIC_INCREMENT(&next_block_id);
+    const int block_id = next_block_id.fetch_add(1);
 
     if (block_id>=NUM_BLOCKS) break;
 
@@ -1076,23 +921,18 @@ void GridGraph_2D_4C_MT<type_tcap,type_ncap,type_flow>::compute_maxflow()
 
   spin_init(&spinlock);
 
-  thread_func_wrapper_arg* wrapper_args = new thread_func_wrapper_arg[NUM_THREADS];
-
   for(int i=0;i<NUM_THREADS;i++)
   {
-    wrapper_args[i].thisptr = (void*)this;
-    wrapper_args[i].arg     = (void*)((intptr_t)i);
-
-    threads[i]->handle = threadCreate(thread_func_wrapper,(void*)&wrapper_args[i]);
+    threads[i]->handle = new std::thread(&GridGraph_2D_4C_MT::thread_func,this,(void*)((intptr_t)i));
   }
 
-  for(int i=0;i<NUM_THREADS;i++) threadJoin(threads[i]->handle);
+  for(int i=0;i<NUM_THREADS;i++)
+  {
+    threads[i]->handle->join();
+    delete threads[i]->handle;
+  }
 
   for(int i=0;i<NUM_THREADS;i++) MAXFLOW_TOTAL += threads[i]->MAXFLOW;
-
-  delete[] wrapper_args;
-
-  spin_destroy(&spinlock);
 }
 
 template <typename type_tcap,typename type_ncap,typename type_flow>
@@ -1372,9 +1212,6 @@ GridGraph_2D_4C_MT<type_tcap,type_ncap,type_flow>::~GridGraph_2D_4C_MT()
   if (mem_pool!=NULL) { free(mem_pool); }
 }
 
-#undef THREAD_FUNC_WRAPPER_DECL
-#undef ATOMIC_INCREMENT
-
 #undef SISTER
 
 #undef LABEL
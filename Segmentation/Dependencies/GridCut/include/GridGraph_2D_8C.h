@@ -58,6 +58,17 @@ public:
                        const type_arg_ncap* cap_gg          // [+1,+1]
                        );
 
+  // Changes the capacities of the source-->node and node-->sink edges by the given
+  // differences after the maxflow was computed. The residual graph is kept
+  // (Kohli & Torr, Dynamic Graph Cuts), so the next call of compute_maxflow only
+  // pushes the flow made possible by the change. The capacities may also decrease,
+  // the flow through the node is then reduced accordingly.
+  inline void update_terminal_cap(int node_id,type_tcap delta_source,type_tcap delta_sink);
+
+  // Removes all edges and the flow, so that the graph can be filled again by set_caps
+  // or the set_*_cap functions and solved without reallocating its memory.
+  void reset();
+
 
   // Computes the maxflow.
   void compute_maxflow();
@@ -163,6 +174,8 @@ private:
 
   type_flow MAXFLOW;
 
+  bool terminals_updated;
+
   const int ow;
   const int oh;
 
@@ -196,6 +209,8 @@ private:
 
   void adopt(const int TIME,const int YOFS);
 
+  void reset_trees();
+
   template<typename T>inline type_ncap mincap(type_ncap a,T b) const
   {
     return a < b ? a : b;
@@ -523,9 +538,100 @@ void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::adopt(const int TIME,const
   }
 }
 
+template <typename type_tcap,typename type_ncap,typename type_flow>
+void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::reset_trees()
+{
+  // Changed terminal edges can invalidate any path in the search trees, so the trees
+  // are rebuilt from the nodes with residual terminal capacity while the residual
+  // capacities of all edges, and thus the flow found so far, are kept.
+  memset(QN,0,W*H*sizeof(int));
+  QF = 0;
+  QB = 0;
+  QN[0] = 1;
+
+  orphans.clear();
+  orphans2.clear();
+  free_nodes.clear();
+
+  for(int v=0;v<W*H;v++)
+  {
+    if (RC_ST(v))
+    {
+      PARENT(v) = TERMINAL;
+    }
+    else
+    {
+      LABEL(v) = LABEL_F;
+      PARENT(v) = NONE;
+    }
+  }
+
+  for(int v=0;v<W*H;v++)
+  {
+    const int lv = LABEL(v);
+    if (lv==LABEL_F) continue;
+
+    const int N_ID[8] = { N_LE(v),N_GE(v),N_EL(v),N_EG(v),N_LL(v),N_GL(v),N_LG(v),N_GG(v) };
+
+    for(int arc=0;arc<8;arc++)
+    {
+      const int N = N_ID[arc];
+      if (lv==LABEL_S)
+      {
+        if (NONSAT(arc,v) && LABEL(N)!=lv) { Q_PUSH_BACK1(v); goto next_node; }
+      }
+      else
+      {
+        if (NONSAT_SISTER(arc,N) && LABEL(N)==LABEL_F) { Q_PUSH_BACK1(v); goto next_node; }
+      }
+    }
+
+    next_node:
+      ;
+  }
+
+  QF = QN[0];
+}
+
+template <typename type_tcap,typename type_ncap,typename type_flow>
+void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::reset()
+{
+  memset(label,LABEL_F,W*H*sizeof(unsigned char));
+  memset(parent,NONE,W*H);
+
+  for(int i=0;i<8;i++)
+  {
+    memset(rc[i],0,W*H*sizeof(type_ncap));
+  }
+
+  memset(rc_st,0,W*H*sizeof(type_tcap));
+  memset(timestamp,0,W*H*sizeof(int));
+
+  memset(QN,0,W*H*sizeof(int));
+  QF = 0;
+  QB = 0;
+  QN[0] = 1;
+
+  orphans.clear();
+  orphans2.clear();
+  free_nodes.clear();
+
+  MAXFLOW = 0;
+
+  TIME = 0;
+
+  terminals_updated = false;
+}
+
 template <typename type_tcap,typename type_ncap,typename type_flow>
 void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::compute_maxflow()
 {
+  if (terminals_updated)
+  {
+    reset_trees();
+    terminals_updated = false;
+  }
+
   while(!free_nodes.empty())
   {
     const int v = free_nodes.pop_front();
@@ -651,6 +757,37 @@ inline void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::set_neighbor_cap(int
   RC(arc,node_id) = cap;
 }
 
+template <typename type_tcap,typename type_ncap,typename type_flow>
+inline void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::update_terminal_cap(int v,type_tcap delta_s,type_tcap delta_t)
+{
+  // Only the edge to the terminal of the node's label has residual capacity
+  const type_tcap cap_s = (LABEL(v)==LABEL_S ? RC_ST(v) : 0) + delta_s;
+  const type_tcap cap_t = (LABEL(v)==LABEL_T ? RC_ST(v) : 0) + delta_t;
+
+  // The common part flows straight through the node, it is negative when
+  // a capacity drops below the flow that was already pushed over the edge
+  MAXFLOW += (cap_s < cap_t) ? cap_s : cap_t;
+
+  if      (cap_s > cap_t)
+  {
+    RC_ST(v) = cap_s-cap_t;
+
+    LABEL(v) = LABEL_S;
+  }
+  else if (cap_s < cap_t)
+  {
+    RC_ST(v) = cap_t-cap_s;
+
+    LABEL(v) = LABEL_T;
+  }
+  else
+  {
+    RC_ST(v) = 0;
+  }
+
+  terminals_updated = true;
+}
+
 template<typename type_tcap,typename type_ncap,typename type_flow> template<typename type_arg_tcap,typename type_arg_ncap>
 inline void GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::set_caps(const type_arg_tcap* cap_s,
                                                                      const type_arg_tcap* cap_t,
@@ -852,6 +989,8 @@ GridGraph_2D_8C<type_tcap,type_ncap,type_flow>::GridGraph_2D_8C(int w,int h) :
   MAXFLOW = 0;
 
   TIME = 0;
+
+  terminals_updated = false;
 }
 
 template <typename type_tcap,typename type_ncap,typename type_flow>
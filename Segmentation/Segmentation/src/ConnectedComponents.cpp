@@ -0,0 +1,242 @@
+#include "ConnectedComponents.hpp"
+#include <algorithm>
+
+void ConnectedComponents::Label(const unsigned char* mask, int width, int height, unsigned char value, bool eightConnected, int blockSize)
+{
+    const int size = width * height;
+    labels = std::make_unique<int[]>(size);
+    stats.clear();
+
+    // Neighbours preceding a pixel in raster order: left, up, up-left and up-right
+    const int numNeighbours = eightConnected ? 4 : 2;
+    const int offsetX[4] = { -1, 0, -1, 1 };
+    const int offsetY[4] = { 0, -1, -1, -1 };
+
+    // First pass, the trees of a block only contain its own pixels, so the blocks are labelled in parallel
+    const int blocksX = (width + blockSize - 1) / blockSize;
+    const int blocksY = (height + blockSize - 1) / blockSize;
+    const int numBlocks = blocksX * blocksY;
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < numBlocks; b++)
+    {
+        const int x0 = (b % blocksX) * blockSize;
+        const int y0 = (b / blocksX) * blockSize;
+        const int x1 = std::min(x0 + blockSize, width);
+        const int y1 = std::min(y0 + blockSize, height);
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                const int p = y * width + x;
+                if (mask[p] != value)
+                {
+                    labels[p] = -1;
+                    continue;
+                }
+                labels[p] = p;
+                for (int n = 0; n < numNeighbours; n++)
+                {
+                    const int qx = x + offsetX[n];
+                    const int qy = y + offsetY[n];
+                    if (qx < x0 || qx >= x1 || qy < y0) continue;
+                    if (mask[qy * width + qx] == value) Union(p, qy * width + qx);
+                }
+            }
+        }
+    }
+
+    // Pixel pairs across the block borders, only the first row and the first and last column of a block have such neighbours
+    auto merge = [&](int x, int y)
+    {
+        const int p = y * width + x;
+        if (mask[p] != value) return;
+        for (int n = 0; n < numNeighbours; n++)
+        {
+            const int qx = x + offsetX[n];
+            const int qy = y + offsetY[n];
+            if (qx < 0 || qx >= width || qy < 0) continue;
+            if (qx / blockSize == x / blockSize && qy / blockSize == y / blockSize) continue;
+            if (mask[qy * width + qx] == value) Union(p, qy * width + qx);
+        }
+    };
+    for (int b = 0; b < numBlocks; b++)
+    {
+        const int x0 = (b % blocksX) * blockSize;
+        const int y0 = (b / blocksX) * blockSize;
+        const int x1 = std::min(x0 + blockSize, width);
+        const int y1 = std::min(y0 + blockSize, height);
+        for (int x = x0; x < x1; x++)
+        {
+            merge(x, y0);
+        }
+        for (int y = y0 + 1; y < y1; y++)
+        {
+            merge(x0, y);
+            if (x1 - 1 > x0) merge(x1 - 1, y);
+        }
+    }
+
+    // Second pass over bands of block rows in parallel. The root of a tree is the first pixel of its component in raster order,
+    // so numbering the roots band by band from the exclusive prefix sum of their counts keeps the raster order of the components.
+    // Every parent precedes its child, a pixel whose parent lies in the same band takes the root already found for the parent
+    // and only parents in earlier bands are followed up the tree, the parents are not modified until all roots are known.
+    const int bands = blocksY;
+    std::unique_ptr<int[]> roots(new int[size]);
+    std::vector<int> bandStart(bands + 1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < bands; b++)
+    {
+        const int first = b * blockSize * width;
+        int count = 0;
+        for (int p = first; p < std::min((b + 1) * blockSize, height) * width; p++)
+        {
+            int root = labels[p];
+            if (root < 0) continue;
+            if (root == p) count++;
+            else if (root >= first) root = roots[root];
+            else while (labels[root] != root) root = labels[root];
+            roots[p] = root;
+        }
+        bandStart[b + 1] = count;
+    }
+    for (int b = 0; b < bands; b++) bandStart[b + 1] += bandStart[b];
+
+    stats.assign(bandStart[bands], ComponentStats());
+    std::vector<double> sumX(stats.size(), 0.0);
+    std::vector<double> sumY(stats.size(), 0.0);
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < bands; b++)
+    {
+        int id = bandStart[b];
+        for (int p = b * blockSize * width; p < std::min((b + 1) * blockSize, height) * width; p++)
+        {
+            if (labels[p] < 0 || roots[p] != p) continue;
+            labels[p] = id;
+            stats[id].minX = stats[id].maxX = p % width;
+            stats[id].minY = stats[id].maxY = p / width;
+            id++;
+        }
+    }
+
+    // Pixels take the label of their root and the statistics are gathered in the same sweep. The components of a band are written
+    // directly, components starting in an earlier band enter it through its first row and are merged after the parallel sweep.
+    struct Partial {
+        int id;
+        ComponentStats stats;
+        double sumX;
+        double sumY;
+    };
+    std::vector<std::vector<Partial>> partials(bands);
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < bands; b++)
+    {
+        const int y0 = b * blockSize;
+        const int y1 = std::min(y0 + blockSize, height);
+        std::vector<Partial>& partial = partials[b];
+        for (int x = 0; x < width; x++)
+        {
+            const int p = y0 * width + x;
+            if (labels[p] < 0 || labels[roots[p]] >= bandStart[b]) continue;
+            Partial entry{ labels[roots[p]], ComponentStats(), 0.0, 0.0 };
+            entry.stats.minX = entry.stats.maxX = x;
+            entry.stats.minY = entry.stats.maxY = y0;
+            partial.push_back(entry);
+        }
+        std::sort(partial.begin(), partial.end(), [](const Partial& l, const Partial& r) { return l.id < r.id; });
+        partial.erase(std::unique(partial.begin(), partial.end(), [](const Partial& l, const Partial& r) { return l.id == r.id; }), partial.end());
+
+        int lastLabel = -1;
+        ComponentStats* component = nullptr;
+        double* sx = nullptr;
+        double* sy = nullptr;
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const int p = y * width + x;
+                if (labels[p] < 0) continue;
+                if (roots[p] != p) labels[p] = labels[roots[p]];
+
+                // Runs of pixels of one component reuse the accumulators found for the first of them
+                const int label = labels[p];
+                if (label != lastLabel)
+                {
+                    lastLabel = label;
+                    if (label >= bandStart[b])
+                    {
+                        component = &stats[label];
+                        sx = &sumX[label];
+                        sy = &sumY[label];
+                    }
+                    else
+                    {
+                        Partial& entry = *std::lower_bound(partial.begin(), partial.end(), label, [](const Partial& entry, int id) { return entry.id < id; });
+                        component = &entry.stats;
+                        sx = &entry.sumX;
+                        sy = &entry.sumY;
+                    }
+                }
+                component->area++;
+                component->minX = std::min(component->minX, x);
+                component->maxX = std::max(component->maxX, x);
+                component->maxY = y;
+                *sx += x;
+                *sy += y;
+            }
+        }
+    }
+    for (int b = 0; b < bands; b++)
+    {
+        for (const Partial& entry : partials[b])
+        {
+            ComponentStats& component = stats[entry.id];
+            component.area += entry.stats.area;
+            component.minX = std::min(component.minX, entry.stats.minX);
+            component.maxX = std::max(component.maxX, entry.stats.maxX);
+            component.maxY = std::max(component.maxY, entry.stats.maxY);
+            sumX[entry.id] += entry.sumX;
+            sumY[entry.id] += entry.sumY;
+        }
+    }
+
+    const int count = static_cast<int>(stats.size());
+    #pragma omp parallel for
+    for (int c = 0; c < count; c++)
+    {
+        stats[c].centroidX = static_cast<float>(sumX[c] / stats[c].area);
+        stats[c].centroidY = static_cast<float>(sumY[c] / stats[c].area);
+    }
+}
+
+int ConnectedComponents::Count() const
+{
+    return static_cast<int>(stats.size());
+}
+
+const int* ConnectedComponents::Labels() const
+{
+    return labels.get();
+}
+
+const std::vector<ComponentStats>& ConnectedComponents::Stats() const
+{
+    return stats;
+}
+
+int ConnectedComponents::Find(int p)
+{
+    while (labels[p] != p)
+    {
+        labels[p] = labels[labels[p]];
+        p = labels[p];
+    }
+    return p;
+}
+
+void ConnectedComponents::Union(int p, int q)
+{
+    const int rootP = Find(p);
+    const int rootQ = Find(q);
+    if (rootP < rootQ) labels[rootQ] = rootP;
+    else if (rootQ < rootP) labels[rootP] = rootQ;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Statistics of one connected component.
+/// </summary>
+struct ComponentStats {
+	int area = 0; // Number of pixels
+	int minX = 0; // Bounding box, inclusive
+	int minY = 0;
+	int maxX = 0;
+	int maxY = 0;
+	float centroidX = 0.0f; // Mean position of the pixels
+	float centroidY = 0.0f;
+};
+
+/// <summary>
+/// Connected component labelling of the pixels of a mask with a given value by union-find in two passes.
+/// The first pass unites the pixels inside square blocks in parallel, the pixel pairs across the block borders are united
+/// serially afterwards. The second pass runs in parallel over bands of block rows: the roots are counted per band, numbered
+/// by an exclusive prefix sum of the counts and the statistics are gathered per band, the components continuing from earlier
+/// bands are accumulated separately and merged at the end.
+/// Components are numbered in raster order of their first pixel.
+/// </summary>
+class ConnectedComponents {
+public:
+
+	ConnectedComponents() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	ConnectedComponents(const ConnectedComponents&) = delete;
+	void operator=(const ConnectedComponents&) = delete;
+	ConnectedComponents(ConnectedComponents&&) = delete;
+	ConnectedComponents& operator=(ConnectedComponents&&) = delete;
+
+	/// <summary>
+	/// Label the components of the pixels whose mask equals a given value.
+	/// </summary>
+	/// <param name="mask">mask of width * height values</param>
+	/// <param name="width">mask width</param>
+	/// <param name="height">mask height</param>
+	/// <param name="value">mask value of the labelled pixels</param>
+	/// <param name="eightConnected">diagonal neighbours are connected too</param>
+	/// <param name="blockSize">side of the blocks labelled in parallel in pixels</param>
+	void Label(const unsigned char* mask, int width, int height, unsigned char value, bool eightConnected = true, int blockSize = 64);
+
+	/// <summary>
+	/// Return number of components.
+	/// </summary>
+	int Count() const;
+
+	/// <summary>
+	/// Return component of each pixel, -1 for the pixels with other mask values.
+	/// </summary>
+	const int* Labels() const;
+
+	/// <summary>
+	/// Return statistics of each component.
+	/// </summary>
+	const std::vector<ComponentStats>& Stats() const;
+
+private:
+
+	/// <summary>
+	/// Return root of the tree of a pixel, halving the path on the way.
+	/// </summary>
+	int Find(int p);
+
+	/// <summary>
+	/// Unite the trees of two pixels, the root with the lower index becomes the root of both.
+	/// </summary>
+	void Union(int p, int q);
+
+	std::unique_ptr<int[]> labels; // Parent pixel during the labelling, component afterwards
+	std::vector<ComponentStats> stats; // Statistics of each component
+};
@@ -0,0 +1,263 @@
+#include "FlowGraph.hpp"
+#include <algorithm>
+#include <climits>
+
+FlowGraph::FlowGraph(int nodes, int edges)
+    : first(nodes, -1), parent(nodes, NONE), terminal(nodes, 0), distance(nodes, 0), stamp(nodes, 0), sink(nodes, 0), active(nodes, 0)
+{
+    head.reserve(2 * edges);
+    next.reserve(2 * edges);
+    residual.reserve(2 * edges);
+}
+
+void FlowGraph::AddEdge(int i, int j, int capacity, int reverseCapacity)
+{
+    const int e = static_cast<int>(head.size());
+    head.push_back(j);
+    next.push_back(first[i]);
+    residual.push_back(capacity);
+    first[i] = e;
+
+    head.push_back(i);
+    next.push_back(first[j]);
+    residual.push_back(reverseCapacity);
+    first[j] = e + 1;
+}
+
+void FlowGraph::AddTerminal(int i, int source, int sink)
+{
+    // Both terminal edges of a node carry their common part of flow right away, only the difference stays residual
+    if (terminal[i] > 0) source += terminal[i];
+    else sink -= terminal[i];
+    flow += std::min(source, sink);
+    terminal[i] = source - sink;
+}
+
+int FlowGraph::Segment(int i) const
+{
+    return parent[i] != NONE && sink[i] ? 1 : 0;
+}
+
+void FlowGraph::SetActive(int i)
+{
+    if (active[i]) return;
+    active[i] = 1;
+    activeQueue.push_back(i);
+}
+
+int FlowGraph::NextActive()
+{
+    while (!activeQueue.empty())
+    {
+        const int i = activeQueue.front();
+        activeQueue.pop_front();
+        active[i] = 0;
+        if (parent[i] != NONE) return i;
+    }
+    return -1;
+}
+
+long long FlowGraph::Maxflow()
+{
+    const int nodes = static_cast<int>(first.size());
+    for (int i = 0; i < nodes; i++)
+    {
+        if (terminal[i] == 0) continue;
+        sink[i] = terminal[i] < 0;
+        parent[i] = TERMINAL;
+        distance[i] = 1;
+        SetActive(i);
+    }
+
+    int current = -1;
+    while (true)
+    {
+        // The node whose growth found the last path keeps growing while it stays in its tree
+        int i = current;
+        if (i >= 0)
+        {
+            active[i] = 0;
+            if (parent[i] == NONE) i = -1;
+        }
+        if (i < 0 && (i = NextActive()) < 0) break;
+
+        // Grow the tree of the node over the edges with residual capacity until it touches the other tree
+        int middle = -1;
+        for (int e = first[i]; e >= 0; e = next[e])
+        {
+            const int j = head[e];
+            if (!sink[i] ? residual[e] == 0 : residual[e ^ 1] == 0) continue;
+
+            if (parent[j] == NONE)
+            {
+                sink[j] = sink[i];
+                parent[j] = e ^ 1;
+                stamp[j] = stamp[i];
+                distance[j] = distance[i] + 1;
+                SetActive(j);
+            }
+            else if (sink[j] != sink[i])
+            {
+                middle = sink[i] ? e ^ 1 : e;
+                break;
+            }
+            else if (stamp[j] <= stamp[i] && distance[j] > distance[i])
+            {
+                // Prefer the shorter path to the terminal
+                parent[j] = e ^ 1;
+                stamp[j] = stamp[i];
+                distance[j] = distance[i] + 1;
+            }
+        }
+
+        time++;
+        if (middle < 0)
+        {
+            current = -1;
+            continue;
+        }
+
+        current = i;
+        active[i] = 1;
+        Augment(middle);
+        while (!orphans.empty())
+        {
+            const int orphan = orphans.front();
+            orphans.pop_front();
+            Adopt(orphan);
+        }
+    }
+    return flow;
+}
+
+void FlowGraph::Augment(int middle)
+{
+    // Edge middle points from the source tree to the sink tree, parent edges point from each node towards its terminal
+    int bottleneck = residual[middle];
+    int i;
+    for (i = head[middle ^ 1]; parent[i] != TERMINAL; i = head[parent[i]])
+    {
+        bottleneck = std::min(bottleneck, residual[parent[i] ^ 1]);
+    }
+    bottleneck = std::min(bottleneck, terminal[i]);
+    for (i = head[middle]; parent[i] != TERMINAL; i = head[parent[i]])
+    {
+        bottleneck = std::min(bottleneck, residual[parent[i]]);
+    }
+    bottleneck = std::min(bottleneck, -terminal[i]);
+
+    // Nodes whose parent edge or terminal edge gets saturated become orphans
+    residual[middle ^ 1] += bottleneck;
+    residual[middle] -= bottleneck;
+    for (i = head[middle ^ 1]; ; )
+    {
+        const int e = parent[i];
+        if (e == TERMINAL) break;
+        residual[e] += bottleneck;
+        residual[e ^ 1] -= bottleneck;
+        const int j = head[e];
+        if (residual[e ^ 1] == 0)
+        {
+            parent[i] = ORPHAN;
+            orphans.push_front(i);
+        }
+        i = j;
+    }
+    terminal[i] -= bottleneck;
+    if (terminal[i] == 0)
+    {
+        parent[i] = ORPHAN;
+        orphans.push_front(i);
+    }
+    for (i = head[middle]; ; )
+    {
+        const int e = parent[i];
+        if (e == TERMINAL) break;
+        residual[e ^ 1] += bottleneck;
+        residual[e] -= bottleneck;
+        const int j = head[e];
+        if (residual[e] == 0)
+        {
+            parent[i] = ORPHAN;
+            orphans.push_front(i);
+        }
+        i = j;
+    }
+    terminal[i] += bottleneck;
+    if (terminal[i] == 0)
+    {
+        parent[i] = ORPHAN;
+        orphans.push_front(i);
+    }
+    flow += bottleneck;
+}
+
+void FlowGraph::Adopt(int i)
+{
+    // Look for the neighbour in the same tree closest to the terminal whose path does not run through an orphan
+    int best = NONE;
+    int bestDistance = INT_MAX;
+    for (int e = first[i]; e >= 0; e = next[e])
+    {
+        if ((sink[i] ? residual[e] : residual[e ^ 1]) == 0) continue;
+        int j = head[e];
+        if (parent[j] == NONE || sink[j] != sink[i]) continue;
+
+        int d = 0;
+        while (true)
+        {
+            if (stamp[j] == time)
+            {
+                d += distance[j];
+                break;
+            }
+            d++;
+            if (parent[j] == TERMINAL)
+            {
+                stamp[j] = time;
+                distance[j] = 1;
+                break;
+            }
+            if (parent[j] == ORPHAN)
+            {
+                d = INT_MAX;
+                break;
+            }
+            j = head[parent[j]];
+        }
+        if (d == INT_MAX) continue;
+
+        if (d < bestDistance)
+        {
+            best = e;
+            bestDistance = d;
+        }
+        // Stamp the distances along the checked path so that the next check stops early
+        for (j = head[e]; stamp[j] != time; j = head[parent[j]])
+        {
+            stamp[j] = time;
+            distance[j] = d--;
+        }
+    }
+
+    parent[i] = best;
+    if (best != NONE)
+    {
+        stamp[i] = time;
+        distance[i] = bestDistance + 1;
+        return;
+    }
+
+    // The node becomes free, its children become orphans and its neighbours in the tree may grow into it again
+    for (int e = first[i]; e >= 0; e = next[e])
+    {
+        const int j = head[e];
+        if (parent[j] == NONE || sink[j] != sink[i]) continue;
+        if ((sink[i] ? residual[e] : residual[e ^ 1]) != 0) SetActive(j);
+        if (parent[j] >= 0 && head[parent[j]] == i)
+        {
+            parent[j] = ORPHAN;
+            orphans.push_back(j);
+        }
+    }
+}
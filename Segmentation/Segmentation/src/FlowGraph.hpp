@@ -0,0 +1,101 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+/// <summary>
+/// Directed graph of arbitrary topology with a source and a sink terminal solved by the Boykov-Kolmogorov maxflow algorithm,
+/// the same algorithm GridCut runs on grids. Used where the nodes are not pixels, e.g. superpixels.
+/// Nodes are numbered from 0, the reverse edge of each edge is stored next to it.
+/// </summary>
+class FlowGraph {
+public:
+
+	/// <summary>
+	/// Create a graph without edges.
+	/// </summary>
+	/// <param name="nodes">number of nodes</param>
+	/// <param name="edges">expected number of edges between nodes, only used to reserve memory</param>
+	FlowGraph(int nodes, int edges = 0);
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	FlowGraph(const FlowGraph&) = delete;
+	void operator=(const FlowGraph&) = delete;
+	FlowGraph(FlowGraph&&) = delete;
+	FlowGraph& operator=(FlowGraph&&) = delete;
+
+	/// <summary>
+	/// Add an edge between two nodes together with its reverse edge.
+	/// </summary>
+	/// <param name="i">first node</param>
+	/// <param name="j">second node</param>
+	/// <param name="capacity">capacity from i to j</param>
+	/// <param name="reverseCapacity">capacity from j to i</param>
+	void AddEdge(int i, int j, int capacity, int reverseCapacity);
+
+	/// <summary>
+	/// Add capacities of the terminal edges of a node, repeated calls accumulate.
+	/// </summary>
+	/// <param name="i">node</param>
+	/// <param name="source">capacity from the source</param>
+	/// <param name="sink">capacity to the sink</param>
+	void AddTerminal(int i, int source, int sink);
+
+	/// <summary>
+	/// Compute the maximum flow, may be called only once.
+	/// </summary>
+	/// <returns>value of the flow</returns>
+	long long Maxflow();
+
+	/// <summary>
+	/// Return segment of a node after the maxflow, 0 for the source and 1 for the sink like GridCut get_segment.
+	/// </summary>
+	int Segment(int i) const;
+
+private:
+
+	static const int NONE = -1; // Parent of a free node
+	static const int TERMINAL = -2; // Parent of a node connected to its terminal
+	static const int ORPHAN = -3; // Parent of a node cut off from its tree
+
+	/// <summary>
+	/// Append a node to the active queue if it is not there yet.
+	/// </summary>
+	void SetActive(int i);
+
+	/// <summary>
+	/// Pop the next active node which still belongs to a tree, -1 if there is none.
+	/// </summary>
+	int NextActive();
+
+	/// <summary>
+	/// Push the bottleneck flow along the path through the edge between the source and the sink tree.
+	/// </summary>
+	void Augment(int middle);
+
+	/// <summary>
+	/// Find a new parent of an orphan within its tree or free it.
+	/// </summary>
+	void Adopt(int i);
+
+	// Nodes
+	std::vector<int> first; // First outgoing edge
+	std::vector<int> parent; // Edge to the parent in the search tree or NONE, TERMINAL, ORPHAN
+	std::vector<int> terminal; // Residual terminal capacity, positive towards the source and negative towards the sink
+	std::vector<int> distance; // Distance to the terminal, valid at the time stamp
+	std::vector<int> stamp; // Time of the last distance update
+	std::vector<unsigned char> sink; // Node belongs to the sink tree
+	std::vector<unsigned char> active; // Node is in the active queue
+
+	// Edges, edge e ^ 1 is the reverse of edge e
+	std::vector<int> head; // Node the edge points to
+	std::vector<int> next; // Next outgoing edge of the same node
+	std::vector<int> residual; // Residual capacity
+
+	std::deque<int> activeQueue; // Nodes whose neighbours may be added to their tree
+	std::deque<int> orphans; // Nodes waiting for adoption
+	int time = 0; // Time stamp of the distances
+	long long flow = 0; // Flow through the terminal edges accumulated so far
+};
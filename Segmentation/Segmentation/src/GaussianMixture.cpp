@@ -0,0 +1,163 @@
+#include "GaussianMixture.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const int CHUNKS{ 64 }; // Pixel ranges accumulated in parallel, OpenMP 2.0 has no array reductions
+const float REGULARIZATION{ 1e-4f }; // Added to the covariance diagonal so that components of flat regions stay invertible
+const float LOG_2PI{ 1.83787706641f };
+
+bool GaussianMixture::Initialize(const Color3* colors, const unsigned char* labels, unsigned char label, int count)
+{
+    std::vector<float> luminance;
+    for (int p = 0; p < count; p++)
+    {
+        if (labels[p] == label) luminance.push_back(colors[p].Y());
+    }
+    if (luminance.empty()) return false;
+
+    // Equally populated luminance ranges, one per component
+    std::sort(luminance.begin(), luminance.end());
+    float bounds[COMPONENTS - 1];
+    for (int k = 0; k < COMPONENTS - 1; k++)
+    {
+        bounds[k] = luminance[(k + 1) * luminance.size() / COMPONENTS];
+    }
+
+    std::unique_ptr<signed char[]> component = std::make_unique<signed char[]>(count);
+    #pragma omp parallel for
+    for (int p = 0; p < count; p++)
+    {
+        component[p] = labels[p] == label ? static_cast<signed char>(std::upper_bound(bounds, bounds + COMPONENTS - 1, colors[p].Y()) - bounds) : -1;
+    }
+    return Learn(colors, component.get(), count);
+}
+
+bool GaussianMixture::Fit(const Color3* colors, const unsigned char* labels, unsigned char label, int count)
+{
+    std::unique_ptr<signed char[]> component = std::make_unique<signed char[]>(count);
+    #pragma omp parallel for
+    for (int p = 0; p < count; p++)
+    {
+        component[p] = labels[p] == label ? static_cast<signed char>(Component(colors[p])) : -1;
+    }
+    return Learn(colors, component.get(), count);
+}
+
+float GaussianMixture::Cost(const Color3& color) const
+{
+    float density[COMPONENTS];
+    float maximum = -INFINITY;
+    for (int k = 0; k < COMPONENTS; k++)
+    {
+        density[k] = used[k] ? LogDensity(k, color) : -INFINITY;
+        maximum = std::max(maximum, density[k]);
+    }
+
+    // Log-sum-exp shifted by the largest term, far away colors would underflow otherwise
+    float sum = 0.0f;
+    for (int k = 0; k < COMPONENTS; k++)
+    {
+        if (used[k]) sum += std::exp(density[k] - maximum);
+    }
+    return -(maximum + std::log(sum));
+}
+
+int GaussianMixture::Component(const Color3& color) const
+{
+    int best = 0;
+    float maximum = -INFINITY;
+    for (int k = 0; k < COMPONENTS; k++)
+    {
+        if (!used[k]) continue;
+        const float density = LogDensity(k, color);
+        if (density > maximum)
+        {
+            maximum = density;
+            best = k;
+        }
+    }
+    return best;
+}
+
+float GaussianMixture::LogDensity(int k, const Color3& color) const
+{
+    const Color3 d = color - mean[k];
+    const float* a = inverse[k];
+    const float q = a[0] * d.x * d.x + a[3] * d.y * d.y + a[5] * d.z * d.z + 2.0f * (a[1] * d.x * d.y + a[2] * d.x * d.z + a[4] * d.y * d.z);
+    return logNorm[k] - 0.5f * q;
+}
+
+bool GaussianMixture::Learn(const Color3* colors, const signed char* component, int count)
+{
+    // Count, sum and sum of products (xx, xy, xz, yy, yz, zz) of the samples of each component per chunk
+    const int STATS = 10;
+    std::vector<double> sums(CHUNKS * COMPONENTS * STATS, 0.0);
+    const int chunk = (count + CHUNKS - 1) / CHUNKS;
+    #pragma omp parallel for
+    for (int c = 0; c < CHUNKS; c++)
+    {
+        for (int p = c * chunk; p < std::min((c + 1) * chunk, count); p++)
+        {
+            if (component[p] < 0) continue;
+            const Color3& x = colors[p];
+            double* s = &sums[(c * COMPONENTS + component[p]) * STATS];
+            s[0] += 1.0;
+            s[1] += x.x;
+            s[2] += x.y;
+            s[3] += x.z;
+            s[4] += x.x * x.x;
+            s[5] += x.x * x.y;
+            s[6] += x.x * x.z;
+            s[7] += x.y * x.y;
+            s[8] += x.y * x.z;
+            s[9] += x.z * x.z;
+        }
+    }
+
+    double total[COMPONENTS][STATS] = {};
+    double samples = 0.0;
+    for (int c = 0; c < CHUNKS; c++)
+    {
+        for (int k = 0; k < COMPONENTS; k++)
+        {
+            for (int i = 0; i < STATS; i++)
+            {
+                total[k][i] += sums[(c * COMPONENTS + k) * STATS + i];
+            }
+            samples += sums[(c * COMPONENTS + k) * STATS];
+        }
+    }
+    if (samples == 0.0) return false;
+
+    for (int k = 0; k < COMPONENTS; k++)
+    {
+        const double* s = total[k];
+        used[k] = s[0] > 0.0;
+        if (!used[k]) continue;
+
+        const double mx = s[1] / s[0], my = s[2] / s[0], mz = s[3] / s[0];
+        const double xx = s[4] / s[0] - mx * mx + REGULARIZATION;
+        const double xy = s[5] / s[0] - mx * my;
+        const double xz = s[6] / s[0] - mx * mz;
+        const double yy = s[7] / s[0] - my * my + REGULARIZATION;
+        const double yz = s[8] / s[0] - my * mz;
+        const double zz = s[9] / s[0] - mz * mz + REGULARIZATION;
+
+        // Inverse of the symmetric covariance by cofactors
+        const double c00 = yy * zz - yz * yz;
+        const double c01 = xz * yz - xy * zz;
+        const double c02 = xy * yz - xz * yy;
+        const double det = std::max(xx * c00 + xy * c01 + xz * c02, 1e-30);
+
+        mean[k] = Color3(static_cast<float>(mx), static_cast<float>(my), static_cast<float>(mz));
+        inverse[k][0] = static_cast<float>(c00 / det);
+        inverse[k][1] = static_cast<float>(c01 / det);
+        inverse[k][2] = static_cast<float>(c02 / det);
+        inverse[k][3] = static_cast<float>((xx * zz - xz * xz) / det);
+        inverse[k][4] = static_cast<float>((xy * xz - xx * yz) / det);
+        inverse[k][5] = static_cast<float>((xx * yy - xy * xy) / det);
+        logNorm[k] = static_cast<float>(std::log(s[0] / samples) - 0.5 * std::log(det) - 1.5 * LOG_2PI);
+    }
+    return true;
+}
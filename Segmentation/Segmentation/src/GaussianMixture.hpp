@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <memory>
+
+/// <summary>
+/// Gaussian mixture model of pixel colors with full 3x3 covariances, the color model of GrabCut (Rother et al.).
+/// The model is fitted by hard EM: every sample is assigned to its most likely component and the components are
+/// re-estimated from their samples. The samples are the pixels of an image whose label equals a given value.
+/// </summary>
+class GaussianMixture {
+public:
+
+	GaussianMixture() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	GaussianMixture(const GaussianMixture&) = delete;
+	void operator=(const GaussianMixture&) = delete;
+	GaussianMixture(GaussianMixture&&) = delete;
+	GaussianMixture& operator=(GaussianMixture&&) = delete;
+
+	/// <summary>
+	/// Fit the components to luminance quantiles of the samples.
+	/// </summary>
+	/// <param name="colors">pixel colors</param>
+	/// <param name="labels">pixel labels</param>
+	/// <param name="label">label of the samples</param>
+	/// <param name="count">number of pixels</param>
+	/// <returns>false if there are no samples</returns>
+	bool Initialize(const Color3* colors, const unsigned char* labels, unsigned char label, int count);
+
+	/// <summary>
+	/// Perform one hard EM step, assign the samples to their most likely components and re-estimate the components.
+	/// </summary>
+	/// <param name="colors">pixel colors</param>
+	/// <param name="labels">pixel labels</param>
+	/// <param name="label">label of the samples</param>
+	/// <param name="count">number of pixels</param>
+	/// <returns>false if there are no samples, the model is kept then</returns>
+	bool Fit(const Color3* colors, const unsigned char* labels, unsigned char label, int count);
+
+	/// <summary>
+	/// Return negative log-likelihood of a color.
+	/// </summary>
+	float Cost(const Color3& color) const;
+
+private:
+
+	static const int COMPONENTS = 5;
+
+	/// <summary>
+	/// Return index of the most likely component of a color.
+	/// </summary>
+	int Component(const Color3& color) const;
+
+	/// <summary>
+	/// Return log of the weighted density of a component at a color.
+	/// </summary>
+	float LogDensity(int k, const Color3& color) const;
+
+	/// <summary>
+	/// Estimate weights, means and covariances of the components from the component of each pixel (-1 if not a sample).
+	/// </summary>
+	bool Learn(const Color3* colors, const signed char* component, int count);
+
+	Color3 mean[COMPONENTS]; // Mean color of each component
+	float inverse[COMPONENTS][6]; // Upper triangle of the inverse covariance of each component (xx, xy, xz, yy, yz, zz)
+	float logNorm[COMPONENTS]; // Log of the weight times the normalization constant of each component
+	bool used[COMPONENTS] = {}; // Components with at least one sample
+};
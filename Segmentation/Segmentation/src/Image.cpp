@@ -1,5 +1,10 @@
 #include "Image.hpp"
+#include "ConnectedComponents.hpp"
+#include "FlowGraph.hpp"
+#include "GaussianMixture.hpp"
+#include "Superpixels.hpp"
 #include <algorithm>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION  
 #include <stb_image.h>
@@ -8,16 +13,79 @@
 
 
 #include <GridGraph_2D_8C.h>
+#include <GridGraph_2D_4C_MT.h>
+#include <chrono>
 const float K{ 4000.0f };
 const Color3 RED{ 1.f, 0.f, 0.f };
 const Color3 BLUE{ 0.f, 0.f, 1.f };
+const int PALETTE_SIZE{ 6 };
+const Color3 PALETTE[PALETTE_SIZE]{ BLUE, RED, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 0.f, 1.f, 1.f }, { 1.f, 0.f, 1.f } }; // Stroke colors of the segments of the multi-label segmentation
 
 const float SQRT2{ 1.41421356237f };
+const int FIXED{ 1 << 20 }; // Terminal capacity of fixed pixels, exceeds the capacity of all edges of a pixel
+const float LIKELIHOOD{ 50.0f }; // Scale of the color log-likelihoods of GrabCut relative to the edge weights
+const float STABLE{ 0.001f }; // Fraction of changed labels at which GrabCut stops
+const int WEIGHT_LEVELS{ 4096 }; // Quantized intensities of the edge weight tables
+
+// Capacity of the edge between two neighbouring pixels, high between bright pixels so that the cut follows dark edges.
+// The exponent is 2, so the power is a plain product which the compiler can vectorize.
+static float EdgeWeight(float intensity1, float intensity2, float dist)
+{
+    const float ratio = std::min(intensity1, intensity2) / dist;
+    return 1.0f + K * ratio * ratio;
+}
+
+// Integer edge weights for the lower intensity of two pixels quantized to WEIGHT_LEVELS, so the capacities of all directions
+// are rounded the same way and the weight is not evaluated per edge. The largest weight 1 + K also fits a short capacity.
+static std::vector<int> WeightTable(float dist)
+{
+    std::vector<int> table(WEIGHT_LEVELS + 1);
+    for (int i = 0; i <= WEIGHT_LEVELS; i++)
+    {
+        const float intensity = static_cast<float>(i) / WEIGHT_LEVELS;
+        table[i] = static_cast<int>(std::lround(EdgeWeight(intensity, intensity, dist)));
+    }
+    return table;
+}
+
+static const std::vector<int> straightWeights = WeightTable(1.0f);
+static const std::vector<int> diagonalWeights = WeightTable(SQRT2);
+
+// Halve the resolution, the image is averaged over 2x2 blocks and a block belongs to a stroke if any of its pixels does
+static void Downsample(const Color3* image, const Color3* brush, int width, int height, Color3* image2, Color3* brush2)
+{
+    const int width2 = (width + 1) / 2;
+    const int height2 = (height + 1) / 2;
+
+    #pragma omp parallel for
+    for (int i = 0; i < height2; i++)
+    {
+        for (int j = 0; j < width2; j++)
+        {
+            Color3 sum(0.0f);
+            Color3 stroke(0.0f);
+            int count = 0;
+            for (int y = 2 * i; y < std::min(2 * i + 2, height); y++)
+            {
+                for (int x = 2 * j; x < std::min(2 * j + 2, width); x++)
+                {
+                    sum += image[y * width + x];
+                    if (brush[y * width + x].z == 1) stroke.z = 1.0f;
+                    if (brush[y * width + x].x == 1) stroke.x = 1.0f;
+                    count++;
+                }
+            }
+            image2[i * width2 + j] = sum / static_cast<float>(count);
+            brush2[i * width2 + j] = stroke;
+        }
+    }
+}
 
 Image::Image(Color3* data, int width, int height) : width(width), height(height)
 {
 
     dataT = std::make_unique<Color3[]>(width * height);
+    segmentationMask = std::make_unique<unsigned char[]>(width * height);
 
     // Make grayscale image and create integer histogram
     for (int i = 0; i < height; i++)
@@ -33,6 +101,8 @@ Image::Image(Color3* data, int width, int height) : width(width), height(height)
     }
 }
 
+Image::~Image() = default;
+
 Image::Image(const char* fileName, bool grayScale) {
     // Load image using stb_image library
     stbi_set_flip_vertically_on_load(true);
@@ -46,6 +116,7 @@ Image::Image(const char* fileName, bool grayScale) {
     }
 
     dataT = std::make_unique<Color3[]>(width * height);
+    segmentationMask = std::make_unique<unsigned char[]>(width * height);
 
     // Make grayscale image and create integer histogram
     for (int i = 0; i < height; i++)
@@ -464,62 +535,887 @@ void Image::ImageStitching(Image& img2)
 }
 
 
+template <typename T>
+void Image::GraphCapacities(const Color3* image, const Color3* brush, int width, int height, bool diagonals, std::unique_ptr<T[]>* caps)
+{
+    const int size = width * height;
+    const int count = diagonals ? CAP_COUNT : CAP_LL;
+    for (int c = 0; c < count; c++)
+    {
+        caps[c] = std::make_unique<T[]>(size);
+    }
+
+    std::unique_ptr<unsigned short[]> level = std::make_unique<unsigned short[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        level[p] = static_cast<unsigned short>(std::min(std::max(image[p].Average(), 0.0f), 1.0f) * WEIGHT_LEVELS + 0.5f);
+        caps[CAP_SOURCE][p] = brush[p].z == 1 ? static_cast<T>(K) : 0;
+        caps[CAP_SINK][p] = brush[p].x == 1 ? static_cast<T>(K) : 0;
+    }
+
+    // Each edge weight is looked up once by the pixel at its upper or left end and stored for both directions,
+    // the rows are independent and the inner loops have no branches
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        const int row = i * width;
+        for (int j = 0; j < width - 1; j++)
+        {
+            const T cap = static_cast<T>(straightWeights[std::min(level[row + j], level[row + j + 1])]);
+            caps[CAP_GE][row + j] = cap;
+            caps[CAP_LE][row + j + 1] = cap;
+        }
+        if (i == height - 1) continue;
+
+        for (int j = 0; j < width; j++)
+        {
+            const T cap = static_cast<T>(straightWeights[std::min(level[row + j], level[row + width + j])]);
+            caps[CAP_EG][row + j] = cap;
+            caps[CAP_EL][row + width + j] = cap;
+        }
+        if (!diagonals) continue;
+
+        for (int j = 0; j < width - 1; j++)
+        {
+            const T cap = static_cast<T>(diagonalWeights[std::min(level[row + j], level[row + width + j + 1])]);
+            caps[CAP_GG][row + j] = cap;
+            caps[CAP_LL][row + width + j + 1] = cap;
+        }
+        for (int j = 1; j < width; j++)
+        {
+            const T cap = static_cast<T>(diagonalWeights[std::min(level[row + j], level[row + width + j - 1])]);
+            caps[CAP_LG][row + j] = cap;
+            caps[CAP_GL][row + width + j - 1] = cap;
+        }
+    }
+}
+
 void Image::Segmentation(const Image& img)
 {
-    typedef GridGraph_2D_8C<int, int, int> Grid;
+    // Short capacities halve the residual capacities of the nodes, so more of the graph stays in cache
+    typedef GridGraph_2D_8C<short, short, int> Grid;
 
     Grid* grid = new Grid(width, height);
 
-    auto weight = [](const Vector3& rgb1, const Vector3& rgb2, float dist)
+    std::unique_ptr<short[]> caps[CAP_COUNT];
+    GraphCapacities(data.get(), img.dataT.get(), width, height, true, caps);
+    grid->set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get(),
+                   caps[CAP_LL].get(), caps[CAP_GL].get(), caps[CAP_LG].get(), caps[CAP_GG].get());
+
+    grid->compute_maxflow();
+
+    for (int i = 0; i < height; i++)
     {
-        const float gamma = 2.0f;
-        return 1.0f + K * std::powf(std::min(rgb1.Average(), rgb2.Average()) / dist, gamma);
-    };
+        for (int j = 0; j < width; j++)
+        {
+            segmentationMask[i * width + j] = static_cast<unsigned char>(grid->get_segment(grid->node_id(j, i)));
+            dataT[i * width + j] = data[i * width + j] * (segmentationMask[i * width + j] ? RED : BLUE);
+        }
+    }
+    segmentationMaskValid = true;
+
+    delete grid;
+}
+
+double Image::SegmentationParallel(const Image& img, int numThreads, int blockSize)
+{
+    typedef GridGraph_2D_4C_MT<short, short, int> Grid;
+
+    Grid* grid = new Grid(width, height, numThreads, blockSize);
+
+    // The MT graph has no per-edge setters, all capacities are handed over at once
+    std::unique_ptr<short[]> caps[CAP_COUNT];
+    GraphCapacities(data.get(), img.dataT.get(), width, height, false, caps);
+    grid->set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get());
+
+    auto start = std::chrono::steady_clock::now();
+    grid->compute_maxflow();
+    auto end = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            segmentationMask[i * width + j] = static_cast<unsigned char>(grid->get_segment(grid->node_id(j, i)));
+            dataT[i * width + j] = data[i * width + j] * (segmentationMask[i * width + j] ? RED : BLUE);
+        }
+    }
+    segmentationMaskValid = true;
+
+    delete grid;
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double Image::SegmentationIncremental(const Image& img)
+{
+    typedef GridGraph_2D_8C<int, int, int> Grid;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (!segmentationGraph)
+    {
+        segmentationGraph = std::make_unique<Grid>(width, height);
+
+        std::unique_ptr<int[]> caps[CAP_COUNT];
+        GraphCapacities(data.get(), img.dataT.get(), width, height, true, caps);
+        segmentationGraph->set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get(),
+                                    caps[CAP_LL].get(), caps[CAP_GL].get(), caps[CAP_LG].get(), caps[CAP_GG].get());
+        segmentationSource = std::move(caps[CAP_SOURCE]);
+        segmentationSink = std::move(caps[CAP_SINK]);
+    }
+    else
+    {
+        // Only the terminal edges of pixels under new strokes change, the neighbour capacities depend on the image alone
+        for (int p = 0; p < width * height; p++)
+        {
+            const int source = img.dataT[p].z == 1 ? K : 0;
+            const int sink = img.dataT[p].x == 1 ? K : 0;
+            if (source == segmentationSource[p] && sink == segmentationSink[p]) continue;
 
+            segmentationGraph->update_terminal_cap(segmentationGraph->node_id(p % width, p / width), source - segmentationSource[p], sink - segmentationSink[p]);
+            segmentationSource[p] = source;
+            segmentationSink[p] = sink;
+        }
+    }
+
+    segmentationGraph->compute_maxflow();
+    auto end = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for
     for (int i = 0; i < height; i++)
     {
         for (int j = 0; j < width; j++)
         {
-            grid->set_terminal_cap(grid->node_id(j, i), img.LookupT(j, i).z == 1 ? K : 0, img.LookupT(j, i).x == 1 ? K : 0);
+            segmentationMask[i * width + j] = static_cast<unsigned char>(segmentationGraph->get_segment(segmentationGraph->node_id(j, i)));
+            dataT[i * width + j] = data[i * width + j] * (segmentationMask[i * width + j] ? RED : BLUE);
+        }
+    }
+    segmentationMaskValid = true;
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double Image::SegmentationBanded(const Image& img, int levels, int band, int tileSize)
+{
+    typedef GridGraph_2D_8C<int, int, int> Grid;
 
-            if (j < width - 1)
+    auto start = std::chrono::steady_clock::now();
+
+    // Image and brush pyramid, level 0 is the full resolution
+    std::vector<std::unique_ptr<Color3[]>> storage;
+    std::vector<const Color3*> images{ data.get() };
+    std::vector<const Color3*> brushes{ img.dataT.get() };
+    std::vector<int> widths{ width };
+    std::vector<int> heights{ height };
+    for (int l = 1; l < levels && widths.back() > 1 && heights.back() > 1; l++)
+    {
+        widths.push_back((widths.back() + 1) / 2);
+        heights.push_back((heights.back() + 1) / 2);
+        storage.push_back(std::make_unique<Color3[]>(widths.back() * heights.back()));
+        storage.push_back(std::make_unique<Color3[]>(widths.back() * heights.back()));
+        Downsample(images.back(), brushes.back(), widths[l - 1], heights[l - 1], storage[storage.size() - 2].get(), storage.back().get());
+        images.push_back(storage[storage.size() - 2].get());
+        brushes.push_back(storage.back().get());
+    }
+
+    // Full graph cut on the coarsest level
+    const int top = static_cast<int>(widths.size()) - 1;
+    std::unique_ptr<unsigned char[]> labels = std::make_unique<unsigned char[]>(widths[top] * heights[top]);
+    {
+        std::unique_ptr<int[]> caps[CAP_COUNT];
+        GraphCapacities(images[top], brushes[top], widths[top], heights[top], true, caps);
+        Grid grid(widths[top], heights[top]);
+        grid.set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get(),
+                      caps[CAP_LL].get(), caps[CAP_GL].get(), caps[CAP_LG].get(), caps[CAP_GG].get());
+        grid.compute_maxflow();
+        for (int i = 0; i < heights[top]; i++)
+        {
+            for (int j = 0; j < widths[top]; j++)
             {
-                const float cap = weight(Lookup(j, i), Lookup(j + 1, i), 1);
-                grid->set_neighbor_cap(grid->node_id(j, i),      1, 0, cap);
-                grid->set_neighbor_cap(grid->node_id(j + 1, i), -1, 0, cap);
+                labels[i * widths[top] + j] = grid.get_segment(grid.node_id(j, i));
             }
+        }
+    }
 
-            if (i < height - 1)
+    for (int l = top - 1; l >= 0; l--)
+    {
+        const int w = widths[l];
+        const int h = heights[l];
+        const int coarseWidth = widths[l + 1];
+
+        // Upsample the labels and cut the band around the boundary between the segments at this level
+        std::unique_ptr<unsigned char[]> fine = std::make_unique<unsigned char[]>(w * h);
+        #pragma omp parallel for
+        for (int i = 0; i < h; i++)
+        {
+            for (int j = 0; j < w; j++)
             {
-                const int cap = weight(Lookup(j, i), Lookup(j, i + 1), 1);
-                grid->set_neighbor_cap(grid->node_id(j, i),     0,  1, cap);
-                grid->set_neighbor_cap(grid->node_id(j, i + 1), 0, -1, cap);
+                fine[i * w + j] = labels[(i / 2) * coarseWidth + j / 2];
             }
+        }
+        labels = std::move(fine);
+
+        RefineBand(images[l], brushes[l], w, h, band, tileSize, labels);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            segmentationMask[i * width + j] = labels[i * width + j];
+            dataT[i * width + j] = data[i * width + j] * (labels[i * width + j] ? RED : BLUE);
+        }
+    }
+    segmentationMaskValid = true;
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void Image::RefineBand(const Color3* image, const Color3* brush, int w, int h, int band, int tileSize, std::unique_ptr<unsigned char[]>& labels)
+{
+    typedef GridGraph_2D_8C<int, int, int> Grid;
+
+    // Mark the pixels around the boundary between the segments
+    std::unique_ptr<unsigned char[]> boundary = std::make_unique<unsigned char[]>(w * h);
+    #pragma omp parallel for
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            const int p = i * w + j;
+            boundary[p] = (j < w - 1 && labels[p] != labels[p + 1]) || (i < h - 1 && labels[p] != labels[p + w]) ||
+                          (j > 0 && labels[p] != labels[p - 1]) || (i > 0 && labels[p] != labels[p - w]);
+        }
+    }
 
-            if (j < width - 1 && i < height - 1)
+    // Dilate the boundary by the band width, rows first and columns second
+    std::unique_ptr<unsigned char[]> rows = std::make_unique<unsigned char[]>(w * h);
+    std::unique_ptr<unsigned char[]> inBand = std::make_unique<unsigned char[]>(w * h);
+    #pragma omp parallel for
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            unsigned char value = 0;
+            for (int x = std::max(j - band, 0); x <= std::min(j + band, w - 1); x++) value |= boundary[i * w + x];
+            rows[i * w + j] = value;
+        }
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            unsigned char value = 0;
+            for (int y = std::max(i - band, 0); y <= std::min(i + band, h - 1); y++) value |= rows[y * w + j];
+            inBand[i * w + j] = value;
+        }
+    }
+
+    // Only tiles crossed by the band are cut, each one with a margin so that the seams between tiles see their neighbours
+    const int tilesX = (w + tileSize - 1) / tileSize;
+    const int tilesY = (h + tileSize - 1) / tileSize;
+    std::vector<int> tiles;
+    for (int t = 0; t < tilesX * tilesY; t++)
+    {
+        const int x0 = (t % tilesX) * tileSize;
+        const int y0 = (t / tilesX) * tileSize;
+        bool crossed = false;
+        for (int i = y0; i < std::min(y0 + tileSize, h) && !crossed; i++)
+        {
+            for (int j = x0; j < std::min(x0 + tileSize, w) && !crossed; j++)
             {
-                const int cap = weight(Lookup(j, i), Lookup(j + 1, i + 1), SQRT2);
-                grid->set_neighbor_cap(grid->node_id(j, i), 1, 1, cap);
-                grid->set_neighbor_cap(grid->node_id(j + 1, i + 1), -1, -1, cap);
+                crossed = inBand[i * w + j] != 0;
             }
-            if (j > 0 && i < height - 1)
+        }
+        if (crossed) tiles.push_back(t);
+    }
+
+    std::unique_ptr<unsigned char[]> refined = std::make_unique<unsigned char[]>(w * h);
+    std::copy(labels.get(), labels.get() + w * h, refined.get());
+    const int numTiles = static_cast<int>(tiles.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < numTiles; t++)
+    {
+        const int x0 = (tiles[t] % tilesX) * tileSize;
+        const int y0 = (tiles[t] / tilesX) * tileSize;
+        const int x1 = std::min(x0 + tileSize, w);
+        const int y1 = std::min(y0 + tileSize, h);
+        const int margin = tileSize / 4;
+        const int ex0 = std::max(x0 - margin, 0);
+        const int ey0 = std::max(y0 - margin, 0);
+        const int ex1 = std::min(x1 + margin, w);
+        const int ey1 = std::min(y1 + margin, h);
+        const int tw = ex1 - ex0;
+        const int th = ey1 - ey0;
+
+        std::unique_ptr<Color3[]> tileImage = std::make_unique<Color3[]>(tw * th);
+        std::unique_ptr<Color3[]> tileBrush = std::make_unique<Color3[]>(tw * th);
+        for (int i = 0; i < th; i++)
+        {
+            for (int j = 0; j < tw; j++)
             {
-                const int cap = weight(Lookup(j, i), Lookup(j - 1, i + 1), SQRT2);
-                grid->set_neighbor_cap(grid->node_id(j, i), -1, 1, cap);
-                grid->set_neighbor_cap(grid->node_id(j - 1, i + 1), 1, -1, cap);
+                tileImage[i * tw + j] = image[(ey0 + i) * w + ex0 + j];
+                tileBrush[i * tw + j] = brush[(ey0 + i) * w + ex0 + j];
+            }
+        }
+
+        std::unique_ptr<int[]> caps[CAP_COUNT];
+        GraphCapacities(tileImage.get(), tileBrush.get(), tw, th, true, caps);
+
+        // Pixels outside the band keep their label by a fixed capacity, so do the pixels on the tile border inside the image
+        for (int i = 0; i < th; i++)
+        {
+            for (int j = 0; j < tw; j++)
+            {
+                const int p = (ey0 + i) * w + ex0 + j;
+                const bool border = (i == 0 && ey0 > 0) || (i == th - 1 && ey1 < h) || (j == 0 && ex0 > 0) || (j == tw - 1 && ex1 < w);
+                if (inBand[p] && !border) continue;
+                caps[CAP_SOURCE][i * tw + j] = labels[p] ? 0 : FIXED;
+                caps[CAP_SINK][i * tw + j] = labels[p] ? FIXED : 0;
+            }
+        }
+
+        Grid grid(tw, th);
+        grid.set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get(),
+                      caps[CAP_LL].get(), caps[CAP_GL].get(), caps[CAP_LG].get(), caps[CAP_GG].get());
+        grid.compute_maxflow();
+
+        for (int i = y0; i < y1; i++)
+        {
+            for (int j = x0; j < x1; j++)
+            {
+                if (inBand[i * w + j]) refined[i * w + j] = grid.get_segment(grid.node_id(j - ex0, i - ey0));
             }
         }
     }
+    labels = std::move(refined);
+}
 
-    grid->compute_maxflow();
+GrabCutStats Image::GrabCut(const Image& img, int iterations)
+{
+    typedef GridGraph_2D_8C<int, int, int> Grid;
+    typedef std::chrono::steady_clock Clock;
+
+    const int size = width * height;
+    GrabCutStats stats;
+
+    // Label 0 marks the source and 1 the sink like the segments of the graph, unbrushed pixels are 2 until the first cut
+    std::unique_ptr<unsigned char[]> strokes = std::make_unique<unsigned char[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        strokes[p] = img.dataT[p].z == 1 ? 0 : img.dataT[p].x == 1 ? 1 : 2;
+    }
 
+    GaussianMixture sourceModel;
+    GaussianMixture sinkModel;
+    auto start = Clock::now();
+    if (!sourceModel.Initialize(data.get(), strokes.get(), 0, size) || !sinkModel.Initialize(data.get(), strokes.get(), 1, size))
+    {
+        std::cerr << "ERROR: GrabCut needs both source and sink strokes.\n";
+        return stats;
+    }
+    stats.modelTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // The edge weights do not depend on the color models, only the terminal capacities are recomputed
+    std::unique_ptr<int[]> caps[CAP_COUNT];
+    GraphCapacities(data.get(), img.dataT.get(), width, height, true, caps);
+
+    std::unique_ptr<unsigned char[]> labels = std::make_unique<unsigned char[]>(size);
+    std::copy(strokes.get(), strokes.get() + size, labels.get());
+    while (stats.iterations < iterations)
+    {
+        start = Clock::now();
+        #pragma omp parallel for
+        for (int p = 0; p < size; p++)
+        {
+            if (strokes[p] < 2)
+            {
+                caps[CAP_SOURCE][p] = strokes[p] == 0 ? FIXED : 0;
+                caps[CAP_SINK][p] = strokes[p] == 1 ? FIXED : 0;
+                continue;
+            }
+            // Only the difference of the costs of both labels matters
+            const float cost = LIKELIHOOD * (sinkModel.Cost(data[p]) - sourceModel.Cost(data[p]));
+            caps[CAP_SOURCE][p] = cost > 0.0f ? static_cast<int>(cost) : 0;
+            caps[CAP_SINK][p] = cost < 0.0f ? static_cast<int>(-cost) : 0;
+        }
+        stats.dataTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        Grid grid(width, height);
+        grid.set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get(),
+                      caps[CAP_LL].get(), caps[CAP_GL].get(), caps[CAP_LG].get(), caps[CAP_GG].get());
+        grid.compute_maxflow();
+
+        int changed = 0;
+        #pragma omp parallel for reduction(+:changed)
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                const unsigned char label = static_cast<unsigned char>(grid.get_segment(grid.node_id(j, i)));
+                if (label != labels[i * width + j]) changed++;
+                labels[i * width + j] = label;
+            }
+        }
+        stats.maxflowTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stats.iterations++;
+        stats.changed = changed;
+        if (changed <= STABLE * size) break;
+
+        start = Clock::now();
+        sourceModel.Fit(data.get(), labels.get(), 0, size);
+        sinkModel.Fit(data.get(), labels.get(), 1, size);
+        stats.modelTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        segmentationMask[p] = labels[p];
+        dataT[p] = data[p] * (labels[p] ? RED : BLUE);
+    }
+    segmentationMaskValid = true;
+
+    return stats;
+}
+
+double Image::SegmentationSuperpixels(const Image& img, int superpixels, bool refine, int band)
+{
+    const int size = width * height;
+    auto start = std::chrono::steady_clock::now();
+
+    // The superpixels and their edges depend on the image alone, they are computed once and reused for the next strokes
+    if (!segmentationSuperpixels || segmentationSuperpixelsRequested != superpixels)
+    {
+        segmentationSuperpixels = std::make_unique<Superpixels>();
+        segmentationSuperpixels->Compute(data.get(), width, height, superpixels);
+        segmentationSuperpixelsRequested = superpixels;
+        const int* region = segmentationSuperpixels->Labels();
+
+        std::unique_ptr<float[]> intensity = std::make_unique<float[]>(size);
+        #pragma omp parallel for
+        for (int p = 0; p < size; p++)
+        {
+            intensity[p] = data[p].Average();
+        }
+
+        // Pixel pairs across the boundaries of superpixels collected per row, consecutive pairs of the same superpixels are summed right away
+        struct Boundary {
+            int a; // Superpixel with the lower label
+            int b; // Superpixel with the higher label
+            float weight; // Sum of the pixel edge weights
+        };
+        std::vector<std::vector<Boundary>> rows(height);
+        #pragma omp parallel for
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                const int p = i * width + j;
+                const int neighbours[2] = { j < width - 1 ? p + 1 : -1, i < height - 1 ? p + width : -1 };
+                for (int q : neighbours)
+                {
+                    if (q < 0 || region[p] == region[q]) continue;
+                    const int a = std::min(region[p], region[q]);
+                    const int b = std::max(region[p], region[q]);
+                    const float weight = EdgeWeight(intensity[p], intensity[q], 1.0f);
+                    if (!rows[i].empty() && rows[i].back().a == a && rows[i].back().b == b) rows[i].back().weight += weight;
+                    else rows[i].push_back({ a, b, weight });
+                }
+            }
+        }
+
+        // One edge per pair of adjacent superpixels
+        std::vector<Boundary> boundaries;
+        for (int i = 0; i < height; i++)
+        {
+            boundaries.insert(boundaries.end(), rows[i].begin(), rows[i].end());
+        }
+        std::sort(boundaries.begin(), boundaries.end(), [](const Boundary& u, const Boundary& v) { return u.a < v.a || (u.a == v.a && u.b < v.b); });
+        segmentationSuperpixelEdges.clear();
+        for (size_t e = 0; e < boundaries.size(); e++)
+        {
+            if (e + 1 < boundaries.size() && boundaries[e + 1].a == boundaries[e].a && boundaries[e + 1].b == boundaries[e].b)
+            {
+                boundaries[e + 1].weight += boundaries[e].weight;
+                continue;
+            }
+            segmentationSuperpixelEdges.push_back(boundaries[e].a);
+            segmentationSuperpixelEdges.push_back(boundaries[e].b);
+            segmentationSuperpixelEdges.push_back(static_cast<int>(boundaries[e].weight));
+        }
+    }
+    const int* region = segmentationSuperpixels->Labels();
+    const int count = segmentationSuperpixels->Count();
+
+    // Terminal capacity of a superpixel is the sum over its brushed pixels
+    std::vector<int> sourcePixels(count, 0);
+    std::vector<int> sinkPixels(count, 0);
+    for (int p = 0; p < size; p++)
+    {
+        if (img.dataT[p].z == 1) sourcePixels[region[p]]++;
+        if (img.dataT[p].x == 1) sinkPixels[region[p]]++;
+    }
+
+    const int numEdges = static_cast<int>(segmentationSuperpixelEdges.size()) / 3;
+    FlowGraph graph(count, numEdges);
+    for (int e = 0; e < numEdges; e++)
+    {
+        const int* edge = &segmentationSuperpixelEdges[3 * e];
+        graph.AddEdge(edge[0], edge[1], edge[2], edge[2]);
+    }
+    for (int k = 0; k < count; k++)
+    {
+        if (sourcePixels[k] || sinkPixels[k]) graph.AddTerminal(k, static_cast<int>(K) * sourcePixels[k], static_cast<int>(K) * sinkPixels[k]);
+    }
+    graph.Maxflow();
+
+    std::unique_ptr<unsigned char[]> labels = std::make_unique<unsigned char[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        labels[p] = static_cast<unsigned char>(graph.Segment(region[p]));
+    }
+    if (refine) RefineBand(data.get(), img.dataT.get(), width, height, band, 64, labels);
+
+    auto end = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        segmentationMask[p] = labels[p];
+        dataT[p] = data[p] * (labels[p] ? RED : BLUE);
+    }
+    segmentationMaskValid = true;
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double Image::SegmentationMultiLabel(const Image& img, int cycles)
+{
+    typedef GridGraph_2D_8C<int, int, int> Grid;
+
+    const int size = width * height;
+    auto start = std::chrono::steady_clock::now();
+
+    // Palette index of each stroke pixel, -1 for unbrushed pixels
+    std::unique_ptr<signed char[]> stroke = std::make_unique<signed char[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        stroke[p] = -1;
+        for (int c = 0; c < PALETTE_SIZE; c++)
+        {
+            const Color3& color = img.dataT[p];
+            if (color.x == PALETTE[c].x && color.y == PALETTE[c].y && color.z == PALETTE[c].z)
+            {
+                stroke[p] = static_cast<signed char>(c);
+                break;
+            }
+        }
+    }
+
+    bool present[PALETTE_SIZE] = {};
+    for (int p = 0; p < size; p++)
+    {
+        if (stroke[p] >= 0) present[stroke[p]] = true;
+    }
+    std::vector<int> colors;
+    for (int c = 0; c < PALETTE_SIZE; c++)
+    {
+        if (present[c]) colors.push_back(c);
+    }
+    if (colors.size() < 2)
+    {
+        std::cerr << "ERROR: Multi-label segmentation needs strokes of at least two palette colors.\n";
+        return 0.0;
+    }
+
+    // Strokes keep their color, the rest starts in the first segment
+    std::unique_ptr<unsigned char[]> labels = std::make_unique<unsigned char[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        labels[p] = static_cast<unsigned char>(stroke[p] >= 0 ? stroke[p] : colors[0]);
+    }
+
+    // Potts weights of the neighbour edges, the same as the binary segmentation
+    std::unique_ptr<int[]> weights[CAP_COUNT];
+    GraphCapacities(data.get(), img.dataT.get(), width, height, true, weights);
+
+    // One graph and one set of capacity arrays serve all expansion moves
+    std::unique_ptr<int[]> caps[CAP_COUNT];
+    for (int c = 0; c < CAP_COUNT; c++)
+    {
+        caps[c] = std::make_unique<int[]>(size);
+    }
+    std::unique_ptr<Grid> grid = std::make_unique<Grid>(width, height);
+
+    const int offsetX[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+    const int offsetY[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+    for (int cycle = 0; cycle < cycles; cycle++)
+    {
+        int changed = 0;
+        for (int alpha : colors)
+        {
+            // Expansion move: pixels in the sink segment switch to alpha, the rest keeps its label. Every pixel sets only
+            // its own capacities, each edge is evaluated from both of its pixels, so the capacities are in units of half a weight.
+            #pragma omp parallel for
+            for (int i = 0; i < height; i++)
+            {
+                for (int j = 0; j < width; j++)
+                {
+                    const int p = i * width + j;
+                    const int label = labels[p];
+                    int source = label != alpha && stroke[p] >= 0 && stroke[p] != alpha ? FIXED : 0;
+                    int sink = 0;
+                    for (int n = 0; n < 8; n++)
+                    {
+                        caps[CAP_LE + n][p] = 0;
+                        const int x = j + offsetX[n];
+                        const int y = i + offsetY[n];
+                        if (label == alpha || x < 0 || x >= width || y < 0 || y >= height) continue;
+
+                        const int q = y * width + x;
+                        const int weight = weights[CAP_LE + n][p];
+                        if (labels[q] == alpha)
+                        {
+                            // The neighbour is alpha in any case, keeping the label separates them
+                            sink += 2 * weight;
+                        }
+                        else if (labels[q] == label)
+                        {
+                            // Separated if exactly one of them switches
+                            caps[CAP_LE + n][p] = 2 * weight;
+                        }
+                        else
+                        {
+                            // Separated unless both switch
+                            sink += weight;
+                            caps[CAP_LE + n][p] = weight;
+                        }
+                    }
+                    caps[CAP_SOURCE][p] = source;
+                    caps[CAP_SINK][p] = sink;
+                }
+            }
+
+            grid->reset();
+            grid->set_caps(caps[CAP_SOURCE].get(), caps[CAP_SINK].get(), caps[CAP_LE].get(), caps[CAP_GE].get(), caps[CAP_EL].get(), caps[CAP_EG].get(),
+                           caps[CAP_LL].get(), caps[CAP_GL].get(), caps[CAP_LG].get(), caps[CAP_GG].get());
+            grid->compute_maxflow();
+
+            #pragma omp parallel for reduction(+:changed)
+            for (int i = 0; i < height; i++)
+            {
+                for (int j = 0; j < width; j++)
+                {
+                    const int p = i * width + j;
+                    if (labels[p] != alpha && grid->get_segment(grid->node_id(j, i)))
+                    {
+                        labels[p] = static_cast<unsigned char>(alpha);
+                        changed++;
+                    }
+                }
+            }
+        }
+        if (changed == 0) break;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        dataT[p] = data[p] * PALETTE[labels[p]];
+    }
+    // The binary mask no longer matches the displayed segments
+    segmentationMaskValid = false;
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double Image::SegmentationWatershed(const Image& img, int levels)
+{
+    const int size = width * height;
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<float[]> intensity = std::make_unique<float[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        intensity[p] = data[p].Average();
+    }
+
+    // Sobel gradient magnitude with replicated borders, the maximum is taken per row as OpenMP 2.0 has no max reduction
+    std::unique_ptr<float[]> gradient = std::make_unique<float[]>(size);
+    std::vector<float> rowMax(height, 0.0f);
+    #pragma omp parallel for
     for (int i = 0; i < height; i++)
     {
+        const float* up = &intensity[std::max(i - 1, 0) * width];
+        const float* row = &intensity[i * width];
+        const float* down = &intensity[std::min(i + 1, height - 1) * width];
         for (int j = 0; j < width; j++)
         {
-            dataT[i * width + j] = data[i * width + j] * (grid->get_segment(grid->node_id(j, i)) ? RED : BLUE);
+            const int l = std::max(j - 1, 0);
+            const int r = std::min(j + 1, width - 1);
+            const float gx = (up[r] + 2.0f * row[r] + down[r]) - (up[l] + 2.0f * row[l] + down[l]);
+            const float gy = (down[l] + 2.0f * down[j] + down[r]) - (up[l] + 2.0f * up[j] + up[r]);
+            gradient[i * width + j] = std::sqrt(gx * gx + gy * gy);
+            rowMax[i] = std::max(rowMax[i], gradient[i * width + j]);
         }
     }
+    const float maxGradient = *std::max_element(rowMax.begin(), rowMax.end());
+    const float scale = maxGradient > 0.0f ? (levels - 1) / maxGradient : 0.0f;
+    std::unique_ptr<int[]> level = std::make_unique<int[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        level[p] = std::min(static_cast<int>(gradient[p] * scale), levels - 1);
+    }
 
-    delete grid;
+    // Hierarchical queue, one FIFO per gradient level linked through the pixels. Every pixel is queued once when it gets
+    // its label and no pixel is queued below the level being flooded, so the flooding runs in linear time.
+    std::vector<int> head(levels, -1);
+    std::vector<int> tail(levels, -1);
+    std::unique_ptr<int[]> next = std::make_unique<int[]>(size);
+    auto push = [&](int p, int l)
+    {
+        next[p] = -1;
+        if (tail[l] < 0) head[l] = p;
+        else next[tail[l]] = p;
+        tail[l] = p;
+    };
+
+    // Label 0 marks the source and 1 the sink like the segments of the graph, pixels not reached yet are 2
+    std::unique_ptr<unsigned char[]> labels = std::make_unique<unsigned char[]>(size);
+    for (int p = 0; p < size; p++)
+    {
+        labels[p] = img.dataT[p].z == 1 ? 0 : img.dataT[p].x == 1 ? 1 : 2;
+        if (labels[p] < 2) push(p, level[p]);
+    }
+
+    // Flood from the lowest level, every reached pixel takes the label of the pixel it was reached from
+    for (int current = 0; current < levels; )
+    {
+        const int p = head[current];
+        if (p < 0)
+        {
+            current++;
+            continue;
+        }
+        head[current] = next[p];
+        if (head[current] < 0) tail[current] = -1;
+
+        const int x = p % width;
+        const int y = p / width;
+        const int neighbours[4] = { x > 0 ? p - 1 : -1, x < width - 1 ? p + 1 : -1, y > 0 ? p - width : -1, y < height - 1 ? p + width : -1 };
+        for (int q : neighbours)
+        {
+            if (q < 0 || labels[q] != 2) continue;
+            labels[q] = labels[p];
+            push(q, std::max(level[q], current));
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    // Pixels of regions without any stroke stay in the source segment
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        segmentationMask[p] = labels[p] == 1;
+        dataT[p] = data[p] * (segmentationMask[p] ? RED : BLUE);
+    }
+    segmentationMaskValid = true;
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int Image::PaletteSize()
+{
+    return PALETTE_SIZE;
+}
+
+Color3 Image::PaletteColor(int label)
+{
+    return PALETTE[label];
+}
+
+std::vector<ComponentStats> Image::FilterSegmentation(int minArea, int maxHoleArea)
+{
+    if (!segmentationMaskValid)
+    {
+        std::cerr << "ERROR: There is no binary segmentation to filter, run one of the binary segmentations first.\n";
+        return {};
+    }
+
+    const int size = width * height;
+    ConnectedComponents components;
+
+    // Islands of the sink segment smaller than the minimum area join the source segment
+    components.Label(segmentationMask.get(), width, height, 1, true);
+    {
+        std::vector<unsigned char> remove(components.Count());
+        for (int c = 0; c < components.Count(); c++)
+        {
+            remove[c] = components.Stats()[c].area < minArea;
+        }
+        const int* labels = components.Labels();
+        #pragma omp parallel for
+        for (int p = 0; p < size; p++)
+        {
+            if (labels[p] >= 0 && remove[labels[p]]) segmentationMask[p] = 0;
+        }
+    }
+
+    // Holes are small source components not touching the image border, they are 4-connected so that they do not leak
+    // through the diagonal gaps of the 8-connected sink segment
+    components.Label(segmentationMask.get(), width, height, 0, false);
+    {
+        std::vector<unsigned char> fill(components.Count());
+        for (int c = 0; c < components.Count(); c++)
+        {
+            const ComponentStats& hole = components.Stats()[c];
+            const bool border = hole.minX == 0 || hole.minY == 0 || hole.maxX == width - 1 || hole.maxY == height - 1;
+            fill[c] = !border && hole.area < maxHoleArea;
+        }
+        const int* labels = components.Labels();
+        #pragma omp parallel for
+        for (int p = 0; p < size; p++)
+        {
+            if (labels[p] >= 0 && fill[labels[p]]) segmentationMask[p] = 1;
+        }
+    }
+
+    components.Label(segmentationMask.get(), width, height, 1, true);
+
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        dataT[p] = data[p] * (segmentationMask[p] ? RED : BLUE);
+    }
+
+    return components.Stats();
+}
+
+void Image::Paint(int x, int y, int radius, const Color3& color)
+{
+    for (int i = std::max(y - radius, 0); i <= std::min(y + radius, height - 1); i++)
+    {
+        for (int j = std::max(x - radius, 0); j <= std::min(x + radius, width - 1); j++)
+        {
+            if ((i - y) * (i - y) + (j - x) * (j - x) <= radius * radius) dataT[i * width + j] = color;
+        }
+    }
 }
\ No newline at end of file
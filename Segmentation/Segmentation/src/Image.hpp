@@ -1,6 +1,22 @@
  #pragma once
 
+#include "ConnectedComponents.hpp"
 #include "Vector3.hpp"
+#include <vector>
+
+class Superpixels;
+template <typename type_tcap, typename type_ncap, typename type_flow> class GridGraph_2D_8C;
+
+/// <summary>
+/// Statistics of a finished GrabCut segmentation.
+/// </summary>
+struct GrabCutStats {
+	int iterations = 0; // Number of performed EM + maxflow iterations
+	int changed = 0; // Number of pixels whose label changed in the last iteration
+	double modelTime = 0.0; // Time of fitting the color models in milliseconds
+	double dataTime = 0.0; // Time of computing the terminal capacities in milliseconds
+	double maxflowTime = 0.0; // Time of the maxflow computations in milliseconds
+};
 
 /// <summary>
 /// Class representing RGB image.
@@ -24,6 +40,8 @@ public:
 	Image(Image&&) = delete;
 	Image& operator=(Image&&) = delete;
 
+	~Image();
+
 	/// <summary>
 	/// Save transformed image as HDR file.
 	/// </summary>
@@ -147,8 +165,145 @@ public:
 
 	void Segmentation(const Image& img);
 
+	/// <summary>
+	/// Segment the image by the multithreaded 4-connected grid cut and store the result to the transformed image.
+	/// The grid is split into square blocks which the threads cut in parallel before the flows along the block boundaries are resolved.
+	/// </summary>
+	/// <param name="img">brush image (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="numThreads">number of threads</param>
+	/// <param name="blockSize">side of the blocks in pixels</param>
+	/// <returns>time of the maxflow computation in milliseconds</returns>
+	double SegmentationParallel(const Image& img, int numThreads, int blockSize = 64);
+
+	/// <summary>
+	/// Segment the image by the 8-connected grid cut and keep the residual graph for the next call. Later calls only apply the
+	/// terminal capacities changed by new brush strokes and augment from the previous flow (dynamic graph cut), the first
+	/// call solves from scratch.
+	/// </summary>
+	/// <param name="img">brush image (blue strokes mark the source, red strokes the sink)</param>
+	/// <returns>time of the update and maxflow computation in milliseconds</returns>
+	double SegmentationIncremental(const Image& img);
+
+	/// <summary>
+	/// Segment the image coarse to fine (banded graph cut). The 8-connected grid cut runs on the coarsest level of an image
+	/// pyramid, each finer level only cuts a band of pixels around the upsampled boundary while the rest keeps its label.
+	/// The band is covered by small overlapping tile graphs, so time and memory scale with the boundary length.
+	/// Thin structures lost at the coarsest level are not recovered.
+	/// </summary>
+	/// <param name="img">brush image (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="levels">number of pyramid levels including the full resolution</param>
+	/// <param name="band">half width of the refined band in pixels</param>
+	/// <param name="tileSize">side of the tiles covering the band in pixels</param>
+	/// <returns>time of the segmentation in milliseconds</returns>
+	double SegmentationBanded(const Image& img, int levels = 3, int band = 2, int tileSize = 64);
+
+	/// <summary>
+	/// Segment the image by GrabCut. Gaussian mixture color models of both segments are fitted to the brush
+	/// strokes, unbrushed pixels get terminal capacities from the likelihoods of their colors and the models are refitted to
+	/// the segments until the labels stabilize. The strokes stay hard constraints.
+	/// </summary>
+	/// <param name="img">brush image (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="iterations">maximum number of iterations</param>
+	/// <returns>number of iterations and time of each phase, no iterations if a stroke color is missing</returns>
+	GrabCutStats GrabCut(const Image& img, int iterations = 10);
+
+	/// <summary>
+	/// Segment the image on superpixels. SLIC superpixels become the nodes of a general graph whose edges sum the pixel
+	/// edge weights along the shared boundaries, so the maxflow runs on thousands of nodes instead of millions of pixels.
+	/// The boundary between the segments can be refined at the pixel level by recutting a band around it.
+	/// The superpixels and their edges are kept for the next call, so later strokes only rerun the small maxflow and the refinement.
+	/// </summary>
+	/// <param name="img">brush image (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="superpixels">approximate number of superpixels</param>
+	/// <param name="refine">recut a band of pixels around the boundary</param>
+	/// <param name="band">half width of the refined band in pixels</param>
+	/// <returns>time of the segmentation in milliseconds</returns>
+	double SegmentationSuperpixels(const Image& img, int superpixels = 10000, bool refine = true, int band = 2);
+
+	/// <summary>
+	/// Segment the image by a marker-controlled watershed (Meyer's flooding), a low-latency alternative to the graph cut.
+	/// The strokes are flooded over the quantized gradient magnitude from the lowest level up with a hierarchical queue,
+	/// so the time is linear in the number of pixels. Unlike the graph cut the boundary follows gradient ridges, not dark lines.
+	/// </summary>
+	/// <param name="img">brush image (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="levels">number of gradient levels, e.g. 256 or 4096</param>
+	/// <returns>time of the segmentation in milliseconds</returns>
+	double SegmentationWatershed(const Image& img, int levels = 256);
+
+	/// <summary>
+	/// Segment the image into several segments by alpha-expansion (Boykov et al.) with the edge weights of the binary segmentation
+	/// as Potts costs. Strokes of each palette color (blue, red, green, yellow, cyan, magenta) mark one segment and stay hard
+	/// constraints. Every expansion move is a binary 8-connected grid cut, all moves reuse one graph.
+	/// </summary>
+	/// <param name="img">brush image</param>
+	/// <param name="cycles">maximum number of cycles over all segments, the optimization stops earlier when a cycle changes no label</param>
+	/// <returns>time of the segmentation in milliseconds, 0 if there are strokes of less than two palette colors</returns>
+	double SegmentationMultiLabel(const Image& img, int cycles = 5);
+
+	/// <summary>
+	/// Return number of palette colors of the multi-label segmentation.
+	/// </summary>
+	static int PaletteSize();
+
+	/// <summary>
+	/// Return stroke color of a segment of the multi-label segmentation.
+	/// </summary>
+	/// <param name="label">segment, 0 to PaletteSize() - 1</param>
+	static Color3 PaletteColor(int label);
+
+	/// <summary>
+	/// Clean the mask of the last binary segmentation and store the result to the transformed image. Components of the sink
+	/// segment smaller than the minimum area are removed first, then holes (components of the source segment not touching
+	/// the image border) smaller than the maximum area are filled.
+	/// </summary>
+	/// <param name="minArea">minimum area of the kept sink components in pixels</param>
+	/// <param name="maxHoleArea">maximum area of the filled holes in pixels</param>
+	/// <returns>area, bounding box and centroid of each component of the cleaned sink segment, empty if the last segmentation was not binary</returns>
+	std::vector<ComponentStats> FilterSegmentation(int minArea, int maxHoleArea);
+
+	/// <summary>
+	/// Draw a filled disk into the transformed image, used to add strokes to a brush image.
+	/// </summary>
+	/// <param name="x">horizontal position of the center</param>
+	/// <param name="y">vertical position of the center</param>
+	/// <param name="radius">radius in pixels</param>
+	/// <param name="color">stroke color</param>
+	void Paint(int x, int y, int radius, const Color3& color);
+
 private:
 
+	/// <summary>
+	/// Order of the capacity arrays of the segmentation graph, the same as the arguments of GridCut set_caps.
+	/// The neighbour arrays hold the outgoing edge of each pixel towards the given offset ([-1, 0] is LE, [+1, 0] GE, [0, -1] EL...).
+	/// </summary>
+	enum Capacity { CAP_SOURCE, CAP_SINK, CAP_LE, CAP_GE, CAP_EL, CAP_EG, CAP_LL, CAP_GL, CAP_LG, CAP_GG, CAP_COUNT };
+
+	/// <summary>
+	/// Compute terminal and neighbour capacities of all pixels in one parallel pass.
+	/// The edge weights are looked up in integer tables, short capacities are enough without the FIXED terminal capacity.
+	/// </summary>
+	/// <param name="image">image data</param>
+	/// <param name="brush">brush data (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <param name="diagonals">also fill the diagonal arrays of the 8-connected graph</param>
+	/// <param name="caps">CAP_COUNT arrays allocated to width * height, capacities across the image border are 0</param>
+	template <typename T>
+	static void GraphCapacities(const Color3* image, const Color3* brush, int width, int height, bool diagonals, std::unique_ptr<T[]>* caps);
+
+	/// <summary>
+	/// Recut a band of pixels around the boundary between the segments by small overlapping 8-connected tile graphs,
+	/// the pixels outside the band keep their labels.
+	/// </summary>
+	/// <param name="image">image data</param>
+	/// <param name="brush">brush data (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="w">image width</param>
+	/// <param name="h">image height</param>
+	/// <param name="band">half width of the band in pixels</param>
+	/// <param name="tileSize">side of the tiles covering the band in pixels</param>
+	/// <param name="labels">segment of each pixel, replaced by the refined labels</param>
+	static void RefineBand(const Color3* image, const Color3* brush, int w, int h, int band, int tileSize, std::unique_ptr<unsigned char[]>& labels);
+
 	/// <summary>
 	/// Update CDF of after image transformation
 	/// </summary>
@@ -165,5 +320,13 @@ private:
 	int height; // Image height
 	std::unique_ptr<Color3[]> data; // Pointer to the original image data
 	std::unique_ptr<Color3[]> dataT; // Pointer to the transformed image data
+	std::unique_ptr<unsigned char[]> segmentationMask; // Segment of each pixel of the last binary segmentation
+	bool segmentationMaskValid = false; // The mask holds the displayed segmentation, cleared by the multi-label segmentation
+	std::unique_ptr<GridGraph_2D_8C<int, int, int>> segmentationGraph; // Residual graph of the last incremental segmentation
+	std::unique_ptr<int[]> segmentationSource; // Source capacities the residual graph was built or last updated with
+	std::unique_ptr<int[]> segmentationSink; // Sink capacities the residual graph was built or last updated with
+	std::unique_ptr<Superpixels> segmentationSuperpixels; // Superpixels of the last superpixel segmentation
+	int segmentationSuperpixelsRequested = 0; // Number of superpixels they were computed for
+	std::vector<int> segmentationSuperpixelEdges; // Adjacent superpixels and the capacity of their edge, three values per edge
 
 };
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "Superpixels.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+const int LAB_TABLE{ 4096 }; // Samples of the CIELAB nonlinearity on [0, 1], std::cbrt dominated the conversion
+
+// CIELAB nonlinearity f(t) sampled at t = i / LAB_TABLE, plus one sample for the interpolation at 1
+static const std::vector<float> labTable = []
+{
+    std::vector<float> table(LAB_TABLE + 1);
+    for (int i = 0; i <= LAB_TABLE; i++)
+    {
+        const float t = static_cast<float>(i) / LAB_TABLE;
+        table[i] = t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+    }
+    return table;
+}();
+
+void Superpixels::Compute(const Color3* image, int width, int height, int count, float compactness, int iterations)
+{
+    const int size = width * height;
+    std::unique_ptr<Color3[]> lab = std::make_unique<Color3[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        lab[p] = Lab(image[p]);
+    }
+
+    // One seed in each cell of a square grid, moved to the lowest gradient of its 3x3 neighbourhood so that it does not start on an edge
+    const int step = std::max(1, static_cast<int>(std::lround(std::sqrt(static_cast<float>(size) / std::max(count, 1)))));
+    const int gridWidth = (width + step - 1) / step;
+    const int gridHeight = (height + step - 1) / step;
+    const int centers = gridWidth * gridHeight;
+    std::vector<Color3> centerColor(centers);
+    std::vector<float> centerX(centers);
+    std::vector<float> centerY(centers);
+    for (int k = 0; k < centers; k++)
+    {
+        const int x = std::min((k % gridWidth) * step + step / 2, width - 1);
+        const int y = std::min((k / gridWidth) * step + step / 2, height - 1);
+        int best = y * width + x;
+        float bestGradient = FLT_MAX;
+        for (int i = std::max(y - 1, 1); i <= std::min(y + 1, height - 2); i++)
+        {
+            for (int j = std::max(x - 1, 1); j <= std::min(x + 1, width - 2); j++)
+            {
+                const int p = i * width + j;
+                const float gradient = SquaredLength(lab[p + 1] - lab[p - 1]) + SquaredLength(lab[p + width] - lab[p - width]);
+                if (gradient < bestGradient)
+                {
+                    bestGradient = gradient;
+                    best = p;
+                }
+            }
+        }
+        centerColor[k] = lab[best];
+        centerX[k] = static_cast<float>(best % width);
+        centerY[k] = static_cast<float>(best / width);
+    }
+
+    labels = std::make_unique<int[]>(size);
+    const float weight = (compactness / step) * (compactness / step);
+    for (int it = 0; it < iterations; it++)
+    {
+        // Assign each pixel to the nearest of the centers seeded within one step of it (the 2x2 cells of the grid shifted by half a cell
+        // that covers the pixel), the same search window as the original SLIC. The candidates are shared by the pixels of a shifted cell.
+        #pragma omp parallel for
+        for (int y = 0; y < height; y++)
+        {
+            const int hy = (y + step / 2) / step;
+            for (int hx = 0; hx <= gridWidth; hx++)
+            {
+                int candidates[4];
+                int numCandidates = 0;
+                for (int cy = std::max(hy - 1, 0); cy <= std::min(hy, gridHeight - 1); cy++)
+                {
+                    for (int cx = std::max(hx - 1, 0); cx <= std::min(hx, gridWidth - 1); cx++)
+                    {
+                        candidates[numCandidates++] = cy * gridWidth + cx;
+                    }
+                }
+
+                for (int x = std::max(hx * step - step / 2, 0); x < std::min(hx * step + step - step / 2, width); x++)
+                {
+                    const int p = y * width + x;
+                    int best = candidates[0];
+                    float bestDistance = FLT_MAX;
+                    for (int c = 0; c < numCandidates; c++)
+                    {
+                        const int k = candidates[c];
+                        const float dx = x - centerX[k];
+                        const float dy = y - centerY[k];
+                        const float distance = SquaredLength(lab[p] - centerColor[k]) + weight * (dx * dx + dy * dy);
+                        if (distance < bestDistance)
+                        {
+                            bestDistance = distance;
+                            best = k;
+                        }
+                    }
+                    labels[p] = best;
+                }
+            }
+        }
+
+        // Move the centers to the mean of their pixels, a row of centers is only assigned pixels within one step of its cells,
+        // so every row of centers sums its own pixels without sharing accumulators between threads
+        #pragma omp parallel for
+        for (int gy = 0; gy < gridHeight; gy++)
+        {
+            std::vector<double> sums(gridWidth * 6, 0.0);
+            for (int y = std::max(gy * step - step / 2, 0); y < std::min((gy + 1) * step + step - step / 2, height); y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    const int p = y * width + x;
+                    if (labels[p] / gridWidth != gy) continue;
+                    double* s = &sums[(labels[p] % gridWidth) * 6];
+                    s[0] += lab[p].x;
+                    s[1] += lab[p].y;
+                    s[2] += lab[p].z;
+                    s[3] += x;
+                    s[4] += y;
+                    s[5] += 1.0;
+                }
+            }
+            for (int gx = 0; gx < gridWidth; gx++)
+            {
+                const double* s = &sums[gx * 6];
+                if (s[5] == 0.0) continue;
+                const int k = gy * gridWidth + gx;
+                centerColor[k] = Color3(static_cast<float>(s[0] / s[5]), static_cast<float>(s[1] / s[5]), static_cast<float>(s[2] / s[5]));
+                centerX[k] = static_cast<float>(s[3] / s[5]);
+                centerY[k] = static_cast<float>(s[4] / s[5]);
+            }
+        }
+    }
+
+    EnforceConnectivity(width, height, step * step / 4);
+}
+
+int Superpixels::Count() const
+{
+    return count;
+}
+
+const int* Superpixels::Labels() const
+{
+    return labels.get();
+}
+
+Color3 Superpixels::Lab(const Color3& rgb)
+{
+    // sRGB primaries to XYZ divided by the white point
+    const float x = (0.4124f * rgb.x + 0.3576f * rgb.y + 0.1805f * rgb.z) / 0.95047f;
+    const float y = 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
+    const float z = (0.0193f * rgb.x + 0.1192f * rgb.y + 0.9505f * rgb.z) / 1.08883f;
+    auto f = [](float t)
+    {
+        if (t >= 1.0f) return std::cbrt(t);
+        const float position = std::max(t, 0.0f) * LAB_TABLE;
+        const int i = static_cast<int>(position);
+        return labTable[i] + (position - i) * (labTable[i + 1] - labTable[i]);
+    };
+    const float fx = f(x), fy = f(y), fz = f(z);
+    return Color3(116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz));
+}
+
+void Superpixels::EnforceConnectivity(int width, int height, int minimum)
+{
+    const int size = width * height;
+    std::unique_ptr<int[]> relabeled = std::make_unique<int[]>(size);
+    std::fill(relabeled.get(), relabeled.get() + size, -1);
+    std::vector<int> component;
+    count = 0;
+    for (int start = 0; start < size; start++)
+    {
+        if (relabeled[start] >= 0) continue;
+
+        // The first pixel of a component in raster order has its left and upper neighbours relabeled already
+        int adjacent = -1;
+        if (start % width > 0) adjacent = relabeled[start - 1];
+        else if (start >= width) adjacent = relabeled[start - width];
+
+        component.clear();
+        component.push_back(start);
+        relabeled[start] = count;
+        for (size_t c = 0; c < component.size(); c++)
+        {
+            const int p = component[c];
+            const int x = p % width;
+            const int neighbours[4] = { x > 0 ? p - 1 : -1, x < width - 1 ? p + 1 : -1, p - width, p + width < size ? p + width : -1 };
+            for (int q : neighbours)
+            {
+                if (q < 0 || relabeled[q] >= 0 || labels[q] != labels[start]) continue;
+                relabeled[q] = count;
+                component.push_back(q);
+            }
+        }
+
+        if (static_cast<int>(component.size()) < minimum && adjacent >= 0)
+        {
+            for (int p : component) relabeled[p] = adjacent;
+        }
+        else
+        {
+            count++;
+        }
+    }
+    labels = std::move(relabeled);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <memory>
+
+/// <summary>
+/// SLIC superpixels (Achanta et al.), k-means clustering of pixels in CIELAB color and image position seeded on a regular grid.
+/// Every pixel only compares the centers seeded in the 3x3 grid cells around it, so the assignment is parallel over the pixels
+/// and the update is parallel over the rows of centers. Small disconnected fragments are merged into a neighbour afterwards.
+/// </summary>
+class Superpixels {
+public:
+
+	Superpixels() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	Superpixels(const Superpixels&) = delete;
+	void operator=(const Superpixels&) = delete;
+	Superpixels(Superpixels&&) = delete;
+	Superpixels& operator=(Superpixels&&) = delete;
+
+	/// <summary>
+	/// Cluster the pixels of an image into superpixels.
+	/// </summary>
+	/// <param name="image">linear RGB image data</param>
+	/// <param name="width">image width</param>
+	/// <param name="height">image height</param>
+	/// <param name="count">approximate number of superpixels</param>
+	/// <param name="compactness">weight of the position against the color, higher values give more regular superpixels</param>
+	/// <param name="iterations">number of k-means iterations</param>
+	void Compute(const Color3* image, int width, int height, int count, float compactness = 10.0f, int iterations = 10);
+
+	/// <summary>
+	/// Return number of superpixels, the labels are 0 to Count() - 1.
+	/// </summary>
+	int Count() const;
+
+	/// <summary>
+	/// Return superpixel label of each pixel.
+	/// </summary>
+	const int* Labels() const;
+
+private:
+
+	/// <summary>
+	/// Convert a linear RGB color to CIELAB (D65 white).
+	/// </summary>
+	static Color3 Lab(const Color3& rgb);
+
+	/// <summary>
+	/// Relabel the 4-connected components of the labels consecutively, components smaller than the minimum are merged into a neighbour.
+	/// </summary>
+	void EnforceConnectivity(int width, int height, int minimum);
+
+	std::unique_ptr<int[]> labels; // Superpixel of each pixel
+	int count = 0; // Number of superpixels
+};
@@ -0,0 +1,319 @@
+#include "Volume.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include <GridGraph_3D_6C.h>
+#include <GridGraph_3D_26C.h>
+#include <GridGraph_3D_6C_MT.h>
+
+// Same weights as the 2D segmentation in Image.cpp
+const float K{ 4000.0f };
+const Color3 RED{ 1.f, 0.f, 0.f };
+const Color3 BLUE{ 0.f, 0.f, 1.f };
+
+// Capacity of the edge between two neighbouring voxels, high between bright voxels so that the cut follows dark edges
+static float EdgeWeight(float intensity1, float intensity2, float dist)
+{
+    const float ratio = std::min(intensity1, intensity2) / dist;
+    return 1.0f + K * ratio * ratio;
+}
+
+bool Volume::Load(const char* pattern, int first, int count, size_t memoryLimit)
+{
+    char fileName[1024];
+    int w, h, components;
+    std::snprintf(fileName, sizeof(fileName), pattern, first);
+    if (count <= 0 || !stbi_info(fileName, &w, &h, &components))
+    {
+        std::cerr << "ERROR: Could not load volume slice '" << fileName << "'.\n";
+        return false;
+    }
+
+    // Original and transformed voxels
+    const size_t bytes = static_cast<size_t>(w) * h * count * 2 * sizeof(Color3);
+    if (bytes > memoryLimit)
+    {
+        std::cerr << "ERROR: Volume " << w << "x" << h << "x" << count << " needs " << bytes / (1 << 20) << " MB, the limit is "
+                  << memoryLimit / (1 << 20) << " MB.\n";
+        return false;
+    }
+
+    width = w;
+    height = h;
+    depth = count;
+    data = std::make_unique<Color3[]>(static_cast<size_t>(width) * height * depth);
+    dataT = std::make_unique<Color3[]>(static_cast<size_t>(width) * height * depth);
+
+    stbi_set_flip_vertically_on_load(true);
+    for (int z = 0; z < depth; z++)
+    {
+        std::snprintf(fileName, sizeof(fileName), pattern, first + z);
+        std::unique_ptr<float, void(*)(void*)> slice(stbi_loadf(fileName, &w, &h, &components, 3), stbi_image_free);
+        if (!slice || w != width || h != height)
+        {
+            std::cerr << "ERROR: Could not load volume slice '" << fileName << "' of size " << width << "x" << height << ".\n";
+            width = height = depth = 0;
+            data.reset();
+            dataT.reset();
+            return false;
+        }
+        const Color3* voxels = reinterpret_cast<const Color3*>(slice.get());
+        std::copy(voxels, voxels + width * height, data.get() + static_cast<size_t>(z) * width * height);
+    }
+    std::copy(data.get(), data.get() + static_cast<size_t>(width) * height * depth, dataT.get());
+    return true;
+}
+
+void Volume::SavePNG(const char* pattern, int first)
+{
+    char fileName[1024];
+    std::unique_ptr<unsigned char[]> tmp = std::make_unique<unsigned char[]>(width * height * 3);
+    for (int z = 0; z < depth; z++)
+    {
+        // Flip vertically
+        const Color3* slice = dataT.get() + static_cast<size_t>(z) * width * height;
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    tmp[(i * width + j) * 3 + c] = static_cast<unsigned char>(std::sqrtf(std::clamp(slice[(height - i - 1) * width + j][c], 0.0f, 1.0f)) * 255);
+                }
+            }
+        }
+        std::snprintf(fileName, sizeof(fileName), pattern, first + z);
+        stbi_write_png(fileName, width, height, 3, tmp.get(), width * 3);
+    }
+}
+
+int Volume::Width() {
+    return width;
+}
+
+int Volume::Height() {
+    return height;
+}
+
+int Volume::Depth() {
+    return depth;
+}
+
+Color3 Volume::Lookup(int x, int y, int z) const
+{
+    return data[(static_cast<size_t>(z) * height + y) * width + x];
+}
+
+Color3 Volume::LookupT(int x, int y, int z) const
+{
+    return dataT[(static_cast<size_t>(z) * height + y) * width + x];
+}
+
+size_t Volume::SegmentationMemory(int width, int height, int depth, VolumeGraph graph)
+{
+    // GridCut pads the grid by one node on each side and rounds it up to blocks of 4x4x4 nodes indexed by int
+    auto padded = [](int size) { return static_cast<size_t>(((size + 1) / 4) * 4 + 4); };
+    const size_t nodes = padded(width) * padded(height) * padded(depth);
+    if (nodes > INT_MAX) return SIZE_MAX;
+    const size_t voxels = static_cast<size_t>(width) * height * depth;
+
+    // Per node: labels, parent and parent id, residual capacities of the neighbour and terminal edges and six int queues,
+    // per voxel: intensity and the capacity arrays handed to set_caps
+    switch (graph)
+    {
+    case VolumeGraph::Grid6:
+    case VolumeGraph::Grid6Parallel:
+        return nodes * (2 + sizeof(int) + 6 * sizeof(int) + sizeof(int) + 6 * sizeof(int)) + voxels * (sizeof(float) + 8 * sizeof(int));
+    case VolumeGraph::Grid26:
+        // The 26-connected graph is filled edge by edge, its 26 capacity arrays would double the memory
+        return nodes * (2 + sizeof(uint32_t) + sizeof(int) + 26 * sizeof(int) + sizeof(int) + 6 * sizeof(int)) + voxels * sizeof(float);
+    }
+    return SIZE_MAX;
+}
+
+bool Volume::Segmentation(const Volume& brush, VolumeGraph graph, double& time, size_t memoryLimit, int numThreads, int blockSize)
+{
+    if (brush.width != width || brush.height != height || brush.depth != depth)
+    {
+        std::cerr << "ERROR: Brush volume " << brush.width << "x" << brush.height << "x" << brush.depth << " does not match the volume "
+                  << width << "x" << height << "x" << depth << ".\n";
+        return false;
+    }
+
+    const size_t bytes = SegmentationMemory(width, height, depth, graph);
+    if (bytes == SIZE_MAX)
+    {
+        std::cerr << "ERROR: Volume " << width << "x" << height << "x" << depth << " has too many voxels for the grid graph.\n";
+        return false;
+    }
+    if (bytes > memoryLimit)
+    {
+        std::cerr << "ERROR: Segmentation of the volume " << width << "x" << height << "x" << depth << " needs " << bytes / (1 << 20)
+                  << " MB, the limit is " << memoryLimit / (1 << 20) << " MB.\n";
+        return false;
+    }
+
+    const int slice = width * height;
+    const int size = slice * depth;
+    std::unique_ptr<float[]> intensity = std::make_unique<float[]>(size);
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        intensity[p] = data[p].Average();
+    }
+
+    std::unique_ptr<unsigned char[]> segment = std::make_unique<unsigned char[]>(size);
+    if (graph == VolumeGraph::Grid26)
+    {
+        typedef GridGraph_3D_26C<int, int, int> Grid;
+        std::unique_ptr<Grid> grid = std::make_unique<Grid>(width, height, depth);
+
+        // Every node sets only its own outgoing arcs. The saturation flags of all 26 arcs of a node share one word that set_neighbor_cap
+        // updates without atomics, so the arcs of a node must not be set by two threads. The weight is symmetric, so both ends of an
+        // edge evaluate the same capacity.
+        int offsets[26][3];
+        float distances[26];
+        int numOffsets = 0;
+        for (int dz = -1; dz <= 1; dz++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (dx == 0 && dy == 0 && dz == 0) continue;
+                    offsets[numOffsets][0] = dx;
+                    offsets[numOffsets][1] = dy;
+                    offsets[numOffsets][2] = dz;
+                    distances[numOffsets] = std::sqrt(static_cast<float>(dx * dx + dy * dy + dz * dz));
+                    numOffsets++;
+                }
+            }
+        }
+        #pragma omp parallel for
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    const int p = z * slice + y * width + x;
+                    for (int o = 0; o < numOffsets; o++)
+                    {
+                        const int dx = offsets[o][0], dy = offsets[o][1], dz = offsets[o][2];
+                        if (x + dx < 0 || x + dx >= width || y + dy < 0 || y + dy >= height || z + dz < 0 || z + dz >= depth) continue;
+
+                        const int cap = static_cast<int>(EdgeWeight(intensity[p], intensity[p + dz * slice + dy * width + dx], distances[o]));
+                        grid->set_neighbor_cap(grid->node_id(x, y, z), dx, dy, dz, cap);
+                    }
+                }
+            }
+        }
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    const int p = z * slice + y * width + x;
+                    grid->set_terminal_cap(grid->node_id(x, y, z), brush.dataT[p].z == 1 ? K : 0, brush.dataT[p].x == 1 ? K : 0);
+                }
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        grid->compute_maxflow();
+        time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        #pragma omp parallel for
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    segment[z * slice + y * width + x] = grid->get_segment(grid->node_id(x, y, z));
+                }
+            }
+        }
+    }
+    else
+    {
+        // Terminal and neighbour capacities in the order of set_caps, each edge weight is stored for both directions
+        enum { SOURCE, SINK, LEE, GEE, ELE, EGE, EEL, EEG, COUNT };
+        std::unique_ptr<int[]> caps[COUNT];
+        for (int c = 0; c < COUNT; c++)
+        {
+            caps[c] = std::make_unique<int[]>(size);
+        }
+        #pragma omp parallel for
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    const int p = z * slice + y * width + x;
+                    caps[SOURCE][p] = brush.dataT[p].z == 1 ? K : 0;
+                    caps[SINK][p] = brush.dataT[p].x == 1 ? K : 0;
+                    if (x < width - 1)
+                    {
+                        caps[GEE][p] = caps[LEE][p + 1] = static_cast<int>(EdgeWeight(intensity[p], intensity[p + 1], 1.0f));
+                    }
+                    if (y < height - 1)
+                    {
+                        caps[EGE][p] = caps[ELE][p + width] = static_cast<int>(EdgeWeight(intensity[p], intensity[p + width], 1.0f));
+                    }
+                    if (z < depth - 1)
+                    {
+                        caps[EEG][p] = caps[EEL][p + slice] = static_cast<int>(EdgeWeight(intensity[p], intensity[p + slice], 1.0f));
+                    }
+                }
+            }
+        }
+
+        auto solve = [&](auto& grid)
+        {
+            grid.set_caps(caps[SOURCE].get(), caps[SINK].get(), caps[LEE].get(), caps[GEE].get(), caps[ELE].get(), caps[EGE].get(), caps[EEL].get(), caps[EEG].get());
+
+            auto start = std::chrono::steady_clock::now();
+            grid.compute_maxflow();
+            time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            #pragma omp parallel for
+            for (int z = 0; z < depth; z++)
+            {
+                for (int y = 0; y < height; y++)
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        segment[z * slice + y * width + x] = grid.get_segment(grid.node_id(x, y, z));
+                    }
+                }
+            }
+        };
+
+        if (graph == VolumeGraph::Grid6Parallel)
+        {
+            std::unique_ptr<GridGraph_3D_6C_MT<int, int, int>> grid = std::make_unique<GridGraph_3D_6C_MT<int, int, int>>(width, height, depth, numThreads, blockSize);
+            solve(*grid);
+        }
+        else
+        {
+            std::unique_ptr<GridGraph_3D_6C<int, int, int>> grid = std::make_unique<GridGraph_3D_6C<int, int, int>>(width, height, depth);
+            solve(*grid);
+        }
+    }
+
+    #pragma omp parallel for
+    for (int p = 0; p < size; p++)
+    {
+        dataT[p] = data[p] * (segment[p] ? RED : BLUE);
+    }
+    return true;
+}
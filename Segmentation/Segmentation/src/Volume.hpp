@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Vector3.hpp"
+#include <memory>
+
+/// <summary>
+/// Grid graph used to segment a volume.
+/// </summary>
+enum class VolumeGraph {
+	Grid6, // 6-connected grid cut
+	Grid26, // 26-connected grid cut, smoother boundaries at about 2.5 times the memory
+	Grid6Parallel // Multithreaded 6-connected grid cut
+};
+
+/// <summary>
+/// Class representing a stack of RGB slices (CT or microscopy sequences) stored as one contiguous array,
+/// voxel [x, y, z] is at index (z * height + y) * width + x.
+/// </summary>
+class Volume {
+public:
+
+	Volume() = default;
+
+	/// <summary>
+	/// Not copyable or movable
+	/// </summary>
+	Volume(const Volume&) = delete;
+	void operator=(const Volume&) = delete;
+	Volume(Volume&&) = delete;
+	Volume& operator=(Volume&&) = delete;
+
+	/// <summary>
+	/// Load a numbered image sequence using stb_image library, all slices must have the same size.
+	/// The size of the stack is read from the first slice and checked against the memory limit before anything is loaded.
+	/// </summary>
+	/// <param name="pattern">printf pattern of the slice file paths with one integer, e.g. "../Resources/ct/slice_%03d.png"</param>
+	/// <param name="first">number of the first slice</param>
+	/// <param name="count">number of slices</param>
+	/// <param name="memoryLimit">maximum number of bytes of the loaded volume</param>
+	/// <returns>false if a slice cannot be loaded, the sizes differ or the volume exceeds the limit</returns>
+	bool Load(const char* pattern, int first, int count, size_t memoryLimit = size_t(8) << 30);
+
+	/// <summary>
+	/// Save the slices of the transformed volume as PNG files.
+	/// </summary>
+	/// <param name="pattern">printf pattern of the slice file paths with one integer</param>
+	/// <param name="first">number of the first slice</param>
+	void SavePNG(const char* pattern, int first = 0);
+
+	/// <summary>
+	/// Return width of the slices.
+	/// </summary>
+	int Width();
+
+	/// <summary>
+	/// Return height of the slices.
+	/// </summary>
+	int Height();
+
+	/// <summary>
+	/// Return number of slices.
+	/// </summary>
+	int Depth();
+
+	/// <summary>
+	/// Get RGB value of the original volume at a given position
+	/// </summary>
+	Color3 Lookup(int x, int y, int z) const;
+
+	/// <summary>
+	/// Get RGB value of the transformed volume at a given position
+	/// </summary>
+	Color3 LookupT(int x, int y, int z) const;
+
+	/// <summary>
+	/// Return estimated number of bytes allocated by the segmentation of a volume (graph and capacity arrays).
+	/// </summary>
+	/// <param name="width">width of the slices</param>
+	/// <param name="height">height of the slices</param>
+	/// <param name="depth">number of slices</param>
+	/// <param name="graph">grid graph</param>
+	/// <returns>number of bytes, SIZE_MAX if the graph cannot index the volume</returns>
+	static size_t SegmentationMemory(int width, int height, int depth, VolumeGraph graph);
+
+	/// <summary>
+	/// Segment the volume by a 3D grid cut and store the result to the transformed volume.
+	/// The memory of the graph is estimated first, the segmentation fails without allocating anything if it exceeds the limit.
+	/// </summary>
+	/// <param name="brush">brush volume of the same size (blue strokes mark the source, red strokes the sink)</param>
+	/// <param name="graph">grid graph</param>
+	/// <param name="time">time of the maxflow computation in milliseconds</param>
+	/// <param name="memoryLimit">maximum number of bytes allocated by the segmentation</param>
+	/// <param name="numThreads">number of threads of the multithreaded graph</param>
+	/// <param name="blockSize">side of the blocks of the multithreaded graph in voxels</param>
+	/// <returns>false if the sizes differ or the graph exceeds the limit</returns>
+	bool Segmentation(const Volume& brush, VolumeGraph graph, double& time, size_t memoryLimit = size_t(8) << 30, int numThreads = 4, int blockSize = 32);
+
+private:
+
+	int width = 0; // Slice width
+	int height = 0; // Slice height
+	int depth = 0; // Number of slices
+	std::unique_ptr<Color3[]> data; // Pointer to the original volume data
+	std::unique_ptr<Color3[]> dataT; // Pointer to the transformed volume data
+};
@@ -1,9 +1,12 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Image.hpp"
+#include "Volume.hpp"
 
 // std
 #include <algorithm>
+#include <chrono>
+#include <thread>
 
 // Load image
 bool grayScale = false;
@@ -24,8 +27,24 @@ Image img("../Resources/kluk.png", grayScale);
 Image img1("../Resources/kluk_brush.png", grayScale);
 
 
+// Volume segmented by [V], a numbered slice sequence with a brush slice for every slice
+const char* volumePattern = "../Resources/volume/slice_%03d.png";
+const char* volumeBrushPattern = "../Resources/volume/brush_%03d.png";
+const char* volumeOutputPattern = "../Resources/volume/output_%03d.png";
+const int volumeSlices = 64;
+
 std::unique_ptr<Color3[]> pixelBuffer;
 
+// Brush strokes painted with the mouse, left button paints the selected palette color (blue marks the source) and right button the sink (red)
+const int BRUSH_RADIUS{ 4 };
+int brushButton = -1;
+int brushColor = 0; // Palette color of the left button, selected by the number keys
+const char* BRUSH_COLOR_NAMES[]{ "blue", "red", "green", "yellow", "cyan", "magenta" };
+
+// Post-processing of the segmentation mask, smaller islands are removed and smaller holes filled
+const int MIN_ISLAND_AREA{ 200 };
+const int MAX_HOLE_AREA{ 1000 };
+
 void updatePixelBuffer() {
     // Update transformed image
     for (int i = 0; i < img.Height(); i++)
@@ -106,7 +125,133 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         img.Segmentation(img1);
         updatePixelBuffer();
     }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        // Doubling thread counts up to the hardware concurrency
+        const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        for (int threads = 1; ; threads = std::min(2 * threads, maxThreads))
+        {
+            double time = img.SegmentationParallel(img1, threads);
+            std::cout << "Threads: " << threads << ", maxflow: " << time << " ms" << std::endl;
+            if (threads == maxThreads) break;
+        }
+        updatePixelBuffer();
+    }
+    if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    {
+        GrabCutStats stats = img.GrabCut(img1);
+        std::cout << "GrabCut: " << stats.iterations << " iterations, " << stats.changed << " labels changed in the last one" << std::endl;
+        std::cout << "Models: " << stats.modelTime << " ms, data term: " << stats.dataTime << " ms, maxflow: " << stats.maxflowTime << " ms" << std::endl;
+        updatePixelBuffer();
+    }
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        Volume volume, brush;
+        if (volume.Load(volumePattern, 0, volumeSlices) && brush.Load(volumeBrushPattern, 0, volumeSlices))
+        {
+            const char* names[] = { "6-connected", "26-connected", "6-connected multithreaded" };
+            const VolumeGraph graphs[] = { VolumeGraph::Grid6, VolumeGraph::Grid26, VolumeGraph::Grid6Parallel };
+            const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            for (int g = 0; g < 3; g++)
+            {
+                double time;
+                if (!volume.Segmentation(brush, graphs[g], time, size_t(8) << 30, maxThreads)) continue;
+                std::cout << "Volume " << names[g] << ": " << Volume::SegmentationMemory(volume.Width(), volume.Height(), volume.Depth(), graphs[g]) / (1 << 20)
+                          << " MB, maxflow: " << time << " ms" << std::endl;
+            }
+            volume.SavePNG(volumeOutputPattern);
+            std::cout << "Segmented slices saved as 'volume/output_*.png'\n";
+        }
+    }
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        double time = img.SegmentationBanded(img1);
+        std::cout << "Banded segmentation: " << time << " ms" << std::endl;
+        updatePixelBuffer();
+    }
+    if (key == GLFW_KEY_U && action == GLFW_PRESS)
+    {
+        double time = img.SegmentationSuperpixels(img1);
+        std::cout << "Superpixel segmentation: " << time << " ms" << std::endl;
+        updatePixelBuffer();
+    }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        std::vector<ComponentStats> components = img.FilterSegmentation(MIN_ISLAND_AREA, MAX_HOLE_AREA);
+        for (const ComponentStats& component : components)
+        {
+            std::cout << "Component: area " << component.area << ", box [" << component.minX << ", " << component.minY << "] - [" << component.maxX << ", "
+                      << component.maxY << "], centroid [" << component.centroidX << ", " << component.centroidY << "]" << std::endl;
+        }
+        updatePixelBuffer();
+    }
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        double time = img.SegmentationMultiLabel(img1);
+        if (time > 0.0)
+        {
+            std::cout << "Multi-label segmentation: " << time << " ms" << std::endl;
+            updatePixelBuffer();
+        }
+    }
+    if (key == GLFW_KEY_W && action == GLFW_PRESS)
+    {
+        // The graph cut is timed as a whole, including the graph construction, to compare it with the watershed
+        auto start = std::chrono::steady_clock::now();
+        img.Segmentation(img1);
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Graph cut segmentation: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+        std::cout << "Watershed segmentation (4096 levels): " << img.SegmentationWatershed(img1, 4096) << " ms" << std::endl;
+        std::cout << "Watershed segmentation (256 levels): " << img.SegmentationWatershed(img1, 256) << " ms" << std::endl;
+        updatePixelBuffer();
+    }
+    if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + Image::PaletteSize() && action == GLFW_PRESS)
+    {
+        brushColor = key - GLFW_KEY_1;
+        std::cout << "Left button paints " << BRUSH_COLOR_NAMES[brushColor] << " strokes" << std::endl;
+    }
+
+}
 
+void paint(GLFWwindow* window)
+{
+    // The original image is drawn in the lower left corner, flipped vertically like the loaded data
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    img1.Paint(static_cast<int>(x), img.Height() - 1 - static_cast<int>(y), BRUSH_RADIUS,
+               brushButton == GLFW_MOUSE_BUTTON_LEFT ? Image::PaletteColor(brushColor) : Color3(1.f, 0.f, 0.f));
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button != GLFW_MOUSE_BUTTON_LEFT && button != GLFW_MOUSE_BUTTON_RIGHT) return;
+
+    if (action == GLFW_PRESS)
+    {
+        brushButton = button;
+        paint(window);
+    }
+    else if (action == GLFW_RELEASE && brushButton == button)
+    {
+        brushButton = -1;
+        if (button == GLFW_MOUSE_BUTTON_LEFT && brushColor > 1)
+        {
+            // Strokes of the other palette colors only mark segments of the multi-label segmentation
+            double time = img.SegmentationMultiLabel(img1);
+            std::cout << "Multi-label segmentation: " << time << " ms" << std::endl;
+        }
+        else
+        {
+            double time = img.SegmentationIncremental(img1);
+            std::cout << "Incremental segmentation: " << time << " ms" << std::endl;
+        }
+        updatePixelBuffer();
+    }
+}
+
+void cursor_position_callback(GLFWwindow* window, double x, double y)
+{
+    if (brushButton >= 0) paint(window);
 }
 
 int main() {
@@ -120,6 +265,17 @@ int main() {
     std::cout << "[C] Non-linear contrast" << std::endl;
     std::cout << "[S] Save transformed image" << std::endl;
     std::cout << "[I] Image segmentation" << std::endl;
+    std::cout << "[P] Image segmentation (multithreaded grid cut, maxflow time per thread count)" << std::endl;
+    std::cout << "[B] Image segmentation (coarse-to-fine banded grid cut)" << std::endl;
+    std::cout << "[U] Image segmentation (graph cut on SLIC superpixels refined at the boundary)" << std::endl;
+    std::cout << "[F] Remove small islands and fill small holes of the last segmentation" << std::endl;
+    std::cout << "[L] Multi-label segmentation (alpha-expansion, one segment per stroke color: blue, red, green, yellow, cyan, magenta)" << std::endl;
+    std::cout << "[W] Image segmentation (marker-controlled watershed, timed against the graph cut)" << std::endl;
+    std::cout << "[M] Image segmentation (GrabCut with color models fitted to the strokes)" << std::endl;
+    std::cout << "[V] Volume segmentation of the slice sequence in 'Resources/volume' (6, 26 and multithreaded 6-connected)" << std::endl;
+    std::cout << "[1]-[6] Stroke color of the left mouse button: blue (source), red (sink), green, yellow, cyan, magenta" << std::endl;
+    std::cout << "[Mouse] Draw strokes of the selected color (left) or sink strokes (right, red), blue and red strokes update the segmentation" << std::endl;
+    std::cout << "        incrementally, strokes of the other colors update the multi-label segmentation" << std::endl;
     
     pixelBuffer = std::make_unique<Color3[]>((2 * img.Width()) * (1.5 * img.Height()));
 
@@ -144,6 +300,8 @@ int main() {
     glfwMakeContextCurrent(window);
 
     glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_position_callback);
 
 
     // Clear histogram area